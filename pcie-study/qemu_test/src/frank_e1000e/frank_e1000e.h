@@ -13,6 +13,17 @@
 #include <linux/iopoll.h>
 #include <linux/netdevice.h>
 #include <linux/etherdevice.h>
+#include <linux/ethtool.h>
+#include <linux/mii.h>
+#include <linux/pm_runtime.h>
+#include <linux/rtnetlink.h>
+#include <linux/hrtimer.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/u64_stats_sync.h>
+#include <net/netdev_queues.h>
+#include <net/pkt_sched.h>
+#include <net/devlink.h>
 
 #define DRIVER_NAME		"frank_e1000e"
 #define DRIVER_VERSION	"1.0.0"
@@ -23,6 +34,8 @@
 #define FRANK_E1000E_DEV_ID_82574L		0x10D3
 
 #define FRANK_E1000E_CTRL_REG			0x00000
+#define   FRANK_E1000E_CTRL_TFCE		BIT(28)
+#define   FRANK_E1000E_CTRL_RFCE		BIT(27)
 #define   FRANK_E1000E_CTRL_RST			BIT(26)
 #define   FRANK_E1000E_CTRL_FRCDPLX		BIT(12)
 #define   FRANK_E1000E_CTRL_FRCSPD		BIT(11)
@@ -31,16 +44,55 @@
 
 #define FRANK_E1000E_STATUS_REG			0x00008
 #define   FRANK_E1000E_STATUS_LU		BIT(1)
+#define   FRANK_E1000E_STATUS_FD		BIT(0)
+
+#define FRANK_E1000E_EECD_REG			0x00010
+#define   FRANK_E1000E_EECD_AUTO_RD		BIT(9)
+
+/* Reset self-clear and NVM auto-load are both polled for at most this long */
+#define FRANK_E1000E_RESET_POLL_US		20
+#define FRANK_E1000E_RESET_TIMEOUT		10000	//10ms
 
 #define FRANK_E1000E_EERD_REG			0x00014
 #define   FRANK_E1000E_EERD_START				BIT(0)
+//The 8254x keep DONE at bit 4 and the word address at bits 15:8
 #define   FRANK_E1000E_EERD_DONE				BIT(1)
-#define   FRANK_E1000E_EERD_ADDR_MASK		GENMASK(15, 2)
-#define   FRANK_E1000E_EERD_ADDR(addr)		(((addr) & GENMASK(13, 0)) << 2)
+#define   FRANK_E1000E_EERD_DONE_8254X			BIT(4)
+#define   FRANK_E1000E_EERD_ADDR_SHIFT			2
+#define   FRANK_E1000E_EERD_ADDR_SHIFT_8254X	8
 #define   FRANK_E1000E_EERD_DATA(val)			(((val) & GENMASK(31,16)) >> 16)
 #define   FRANK_E1000E_EERD_TIMEOUT		10000	//10ms
+#define   FRANK_E1000E_EERD_POLL_US		1
+
+/* Words 0x00-0x3F hold everything the driver uses, checksum included */
+#define FRANK_E1000E_NVM_WORDS			64
+#define FRANK_E1000E_NVM_MAC_ADDR		0x00
+#define FRANK_E1000E_NVM_CHECKSUM		0x3F
+#define FRANK_E1000E_NVM_SUM			0xBABA
+
+#define FRANK_E1000E_MDIC_REG			0x00020
+#define   FRANK_E1000E_MDIC_DATA(val)		((val) & GENMASK(15, 0))
+#define   FRANK_E1000E_MDIC_REGADD(reg)		(((reg) & GENMASK(4, 0)) << 16)
+#define   FRANK_E1000E_MDIC_PHYADD(phy)		(((phy) & GENMASK(4, 0)) << 21)
+#define   FRANK_E1000E_MDIC_OP_WRITE		(0x1 << 26)
+#define   FRANK_E1000E_MDIC_OP_READ			(0x2 << 26)
+#define   FRANK_E1000E_MDIC_READY			BIT(28)
+#define   FRANK_E1000E_MDIC_ERROR			BIT(30)
+#define   FRANK_E1000E_MDIC_TIMEOUT			(10 * 1000)	//10ms
+#define   FRANK_E1000E_PHY_ADDR				1
+
+//Flow control: pause frame address, type and transmit timer
+#define FRANK_E1000E_FCAL_REG			0x00028
+#define   FRANK_E1000E_FCAL_VAL			0x00C28001
+#define FRANK_E1000E_FCAH_REG			0x0002C
+#define   FRANK_E1000E_FCAH_VAL			0x00000100
+#define FRANK_E1000E_FCT_REG			0x00030
+#define   FRANK_E1000E_FCT_VAL			0x00008808
+#define FRANK_E1000E_FCTTV_REG			0x00170
+#define   FRANK_E1000E_FC_PAUSE_TIME	0x0680
 
 #define FRANK_E1000E_CTRL_EXT			0x00018
+#define   FRANK_E1000E_CTRL_EXT_RO_DIS	BIT(17)
 #define   FRANK_E1000E_CTRL_EXT_EIAME	BIT(24)
 #define   FRANK_E1000E_CTRL_EXT_IAME	BIT(27)
 #define   FRANK_E1000E_CTRL_EXT_PBA_CLR	BIT(31)
@@ -48,7 +100,12 @@
 
 #define FRANK_E1000E_ICR_REG			0x000C0
 #define   FRANK_E1000E_ICR_LSC			BIT(2)
+#define   FRANK_E1000E_ICR_INT_ASSERTED	BIT(31)
 
+#define FRANK_E1000E_ITR_REG			0x000C4
+//Minimum gap between interrupts in 256ns units, for ITR and EITR alike.
+//195 caps a vector at ~20k/s
+#define   FRANK_E1000E_ITR_20K			195
 #define FRANK_E1000E_IMC_REG			0x000D8
 #define FRANK_E1000E_IMS_REG			0x000D0
 
@@ -81,8 +138,13 @@
 		(FRANK_E1000E_INT_LSC | FRANK_E1000E_INT_RXO |\
 		FRANK_E1000E_INT_MDAC | FRANK_E1000E_INT_SRPD |\
 		FRANK_E1000E_INT_ACK | FRANK_E1000E_INT_MNG)
+//Causes left enabled in poll mode, the rings are serviced from the timer
+#define   FRANK_E1000E_INT_POLL_MODE \
+		(FRANK_E1000E_INT_OTHER_MASK | FRANK_E1000E_INT_OTHER)
 	
 #define FRANK_E1000E_EIAC		0x000DC
+/* Causes masked in IMS by an MSI-X message (EIAME) or an ICR read (IAME) */
+#define FRANK_E1000E_IAM		0x000E0
 
 
 #define FRANK_E1000E_IVAR						0x000E4
@@ -121,9 +183,45 @@
 #define   FRANK_E1000E_RCTL_BSIZE_8192(val)	((val | FRANK_E1000E_RCTL_BSEX) | 2 << 16)
 #define   FRANK_E1000E_RCTL_BSIZE_4096(val)	((val | FRANK_E1000E_RCTL_BSEX) | 3 << 16)
 
+//RX/TX split of the on-chip packet buffer in KB, latched by the next reset
+#define FRANK_E1000E_PBA_REG			0x01000
+#define   FRANK_E1000E_PBA_RXA(v)		((v) & GENMASK(15, 0))
+#define   FRANK_E1000E_PBA_TOTAL_82574	40
+#define   FRANK_E1000E_PBA_TOTAL_82571	48
+#define   FRANK_E1000E_PBA_TOTAL_8254X	64
+#define   FRANK_E1000E_PBA_RX_82574		20
+#define   FRANK_E1000E_PBA_RX_82571		32
+#define   FRANK_E1000E_PBA_RX_8254X		48
+
+//Receive FIFO watermarks in bytes, 8 byte granularity
+#define FRANK_E1000E_FCRTL_REG			0x02160
+#define   FRANK_E1000E_FCRTL_XONE		BIT(31)
+#define FRANK_E1000E_FCRTH_REG			0x02168
+#define   FRANK_E1000E_FCRT_MASK		GENMASK(15, 3)
+//Lowest XOFF watermark, leaves room for an XON one 8 bytes below it
+#define   FRANK_E1000E_FCRTH_MIN		16
+
+#define FRANK_E1000E_RXCSUM_REG			0x05000
+#define   FRANK_E1000E_RXCSUM_IPOFL		BIT(8)
+#define   FRANK_E1000E_RXCSUM_TUOFL		BIT(9)
+//Report the RSS hash in the descriptor instead of the packet checksum
+#define   FRANK_E1000E_RXCSUM_PCSD		BIT(13)
+
 #define FRANK_E1000E_RFCTL_REG			0x05008
 #define   FRANK_E1000E_RFCTL_EXSTEN		BIT(15)
 
+#define FRANK_E1000E_MRQC_REG			0x05818
+#define   FRANK_E1000E_MRQC_RSS_EN		BIT(0)
+#define   FRANK_E1000E_MRQC_TCP_IPV4	BIT(16)
+#define   FRANK_E1000E_MRQC_IPV4		BIT(17)
+#define   FRANK_E1000E_MRQC_TCP_IPV6_EX	BIT(18)
+#define   FRANK_E1000E_MRQC_IPV6_EX		BIT(19)
+#define   FRANK_E1000E_MRQC_IPV6		BIT(20)
+#define FRANK_E1000E_RETA_REG(n)		(0x05C00 + ((n) * 4))
+#define   FRANK_E1000E_RETA_WORDS		32
+#define FRANK_E1000E_RSSRK_REG(n)		(0x05C80 + ((n) * 4))
+#define   FRANK_E1000E_RSSRK_WORDS		10
+
 
 
 #define FRANK_E1000E_RDBAL0_REG			0x02800
@@ -131,6 +229,25 @@
 #define FRANK_E1000E_RDLEN0_REG			0x02808
 #define FRANK_E1000E_RDH0_REG			0x02810
 #define FRANK_E1000E_RDT0_REG			0x02818
+//Delay timers count in 1.024 us increments
+#define FRANK_E1000E_RDTR_REG			0x02820
+#define   FRANK_E1000E_RDTR_FPD			BIT(31)
+#define FRANK_E1000E_RXDCTL0_REG		0x02828
+#define FRANK_E1000E_RADV_REG			0x0282C
+#define   FRANK_E1000E_DELAY_MAX		GENMASK(15, 0)
+#define   FRANK_E1000E_DELAY_MAX_USECS	67107
+#define   FRANK_E1000E_USECS_TO_DELAY(us)	((us) * 1000 / 1024)
+#define   FRANK_E1000E_DELAY_TO_USECS(d)	((d) * 1024 / 1000)
+
+//Shared layout of RXDCTL and TXDCTL
+#define   FRANK_E1000E_DCTL_PTHRESH_MASK	GENMASK(5, 0)
+#define   FRANK_E1000E_DCTL_PTHRESH(n)		(((n) & GENMASK(5, 0)) << 0)
+#define   FRANK_E1000E_DCTL_HTHRESH_MASK	GENMASK(13, 8)
+#define   FRANK_E1000E_DCTL_HTHRESH(n)		(((n) & GENMASK(5, 0)) << 8)
+#define   FRANK_E1000E_DCTL_WTHRESH_MASK	GENMASK(21, 16)
+#define   FRANK_E1000E_DCTL_WTHRESH(n)		(((n) & GENMASK(5, 0)) << 16)
+#define   FRANK_E1000E_DCTL_GRAN			BIT(24)
+#define   FRANK_E1000E_DCTL_THRESH_MAX		63
 
 
 #define FRANK_E1000E_TCTL_REG			0x00400
@@ -158,11 +275,34 @@
 #define FRANK_E1000E_TDLEN_REG			0x03808
 #define FRANK_E1000E_TDH_REG			0x03810
 #define FRANK_E1000E_TDT_REG			0x03818
+#define FRANK_E1000E_TXDCTL0_REG		0x03828
+#define FRANK_E1000E_TARC0_REG			0x03840
+#define   FRANK_E1000E_TARC_COUNT_MASK	GENMASK(6, 0)
+#define   FRANK_E1000E_TARC_COUNT(n)	((n) & FRANK_E1000E_TARC_COUNT_MASK)
+#define   FRANK_E1000E_TARC_ENABLE		BIT(10)
+/* Queue 1 registers sit 0x100 above the queue 0 ones */
+#define FRANK_E1000E_TXQ_REG(reg, n)	((reg) + (n) * 0x100)
 
 #define FRANK_E1000E_GCR_REG			0x05B00
 #define   FRANK_E1000E_GCR_SW_INIT		BIT(22)
 
 #define FRANK_E1000E_TX_RING_SIZE	256
+/* The 82574L has two TX queues, the 8254x parts a single one */
+#define FRANK_E1000E_MAX_TX_QUEUES	2
+/* mqprio: TC0 on queue 0 for bulk traffic, TC1 on queue 1 for control */
+#define FRANK_E1000E_NUM_TC			2
+/* TARC counts, equal without mqprio, weighted towards TC1 with it */
+#define FRANK_E1000E_TX_WEIGHT_MAX		127
+#define FRANK_E1000E_TX_WEIGHT_EQUAL	1
+#define FRANK_E1000E_TX_WEIGHT0_DEFAULT	1
+#define FRANK_E1000E_TX_WEIGHT1_DEFAULT	FRANK_E1000E_TX_WEIGHT_MAX
+/* Free descriptors needed before a stopped queue is woken again */
+#define FRANK_E1000E_TX_WAKE_THRESHOLD	32
+/*
+ * Upper bound of descriptors reclaimed per ring and NAPI poll. A ring never
+ * holds more than size - 1, so it has to stay below that to ever matter.
+ */
+#define FRANK_E1000E_TX_CLEAN_BUDGET	64
 
 #define FRANK_E1000E_TXD_CMD_EOP	BIT(0)	/* End of Packet */
 #define FRANK_E1000E_TXD_CMD_IFCS	BIT(1)	/* Insert FCS */
@@ -173,8 +313,59 @@
 
 #define FRANK_E1000E_RX_RING_SIZE	256
 
+/* Refilled RX slots are handed back to the NIC in batches of this many */
+#define FRANK_E1000E_RX_BUFFER_WRITE	16
+
+#define FRANK_E1000E_RX_COPYBREAK_DEFAULT	256
+#define FRANK_E1000E_RX_COPYBREAK_MAX		2048
+
+/* Every TX slot owns a pre-mapped bounce buffer of this size */
+#define FRANK_E1000E_TX_BOUNCE_SIZE			256
+#define FRANK_E1000E_TX_COPYBREAK_DEFAULT	128
+
+/*
+ * Descriptor fetch/write-back thresholds. Four 16 byte descriptors fill a
+ * 64 byte cache line, so write-backs are batched at that granularity.
+ */
+#define FRANK_E1000E_RX_PTHRESH_DEFAULT		32
+#define FRANK_E1000E_RX_HTHRESH_DEFAULT		4
+#define FRANK_E1000E_RX_WTHRESH_DEFAULT		4
+#define FRANK_E1000E_TX_PTHRESH_DEFAULT		31
+#define FRANK_E1000E_TX_HTHRESH_DEFAULT		1
+#define FRANK_E1000E_TX_WTHRESH_DEFAULT		1
+
+/*
+ * RX WTHRESH only batches while the packet timer runs, so it runs by
+ * default. The absolute timer bounds how long a trickle of frames can
+ * keep pushing the write-back out.
+ */
+#define FRANK_E1000E_RX_DELAY_DEFAULT		8
+#define FRANK_E1000E_RX_ABS_DELAY_DEFAULT	32
+
+#define FRANK_E1000E_TX_TIMEOUT		(5 * HZ)
+
+/* Shortest poll mode period, below it the hardirq timer livelocks its CPU */
+#define FRANK_E1000E_POLL_MIN_US	10
+
+/* Idle time before a downed interface lets the device drop to D3hot */
+#define FRANK_E1000E_AUTOSUSPEND_MS	2000
+
+/*
+ * RX status and errors. The legacy status and errors bytes line up with
+ * bits 7:0 and 31:24 of the extended status_error dword, so one set of
+ * masks covers both layouts.
+ */
 #define FRANK_E1000E_RX_STAT_DD		BIT(0)
 #define FRANK_E1000E_RX_STAT_EOP	BIT(1)
+#define FRANK_E1000E_RX_STAT_IXSM	BIT(2)
+#define FRANK_E1000E_RX_STAT_UDPCS	BIT(4)
+#define FRANK_E1000E_RX_STAT_TCPCS	BIT(5)
+#define FRANK_E1000E_RX_ERR_TCPE	BIT(29)
+#define FRANK_E1000E_RX_ERR_IPE		BIT(30)
+
+#define FRANK_E1000E_RX_MRQ_RSSTYPE		GENMASK(3, 0)
+#define   FRANK_E1000E_RSSTYPE_TCP_IPV4	1
+#define   FRANK_E1000E_RSSTYPE_TCP_IPV6	3
 
 #define FRANK_E1000E_MSIX_RX		0
 #define FRANK_E1000E_MSIX_TX		1
@@ -185,6 +376,10 @@
 #define FRANK_E1000E_MSIX_TX_NAME	"TX"
 #define FRANK_E1000E_MSIX_OTHER_NAME	"Other"
 
+enum frank_e1000e_state {
+	__FRANK_E1000E_DOWN,
+};
+
 struct frank_e1000e_adapter;
 struct frank_e1000e_hw;
 struct frank_e1000e_tx_desc;
@@ -195,9 +390,30 @@ struct frank_e1000e_msix {
 	irqreturn_t (*handler)(int irq, void *data);
 };
 
+/* GCR, EECD.AUTO_RD, IAM and ICR.INT_ASSERTED */
+#define FRANK_E1000E_FLAG_PCIE		BIT(0)
+/* IVAR and EITR, one vector each for RX, TX and other causes. Needs EXT_RX */
+#define FRANK_E1000E_FLAG_MSIX		BIT(1)
+/* Extended RX descriptors with the RSS hash */
+#define FRANK_E1000E_FLAG_EXT_RX	BIT(2)
+
+/*
+ * What sets the MAC families apart, picked from the PCI ID table at probe.
+ * Everything on the packet path is derived from it once, up front.
+ */
+struct frank_e1000e_info {
+	u32				flags;
+	unsigned int	num_tx_queues;
+	u32				pba_total_kb;
+	u32				pba_rx_kb;
+	u32				eerd_addr_shift;
+	u32				eerd_done;
+};
+
 struct frank_e1000e_hw {
 	void __iomem 					*hw_addr;
 	struct frank_e1000e_adapter		*adapter;
+	const struct frank_e1000e_info	*info;
 	u16		device_id;
 	u16		vendor_id;
 };
@@ -232,30 +448,213 @@ struct frank_e1000e_legacy_rx_desc {
 	__le16	special;
 };
 
+/*
+ * Extended RX descriptor, used whenever the part has RFCTL.EXSTEN. The
+ * write-back overwrites the buffer address, see rx_buffer_info.
+ */
+union frank_e1000e_rx_desc {
+	struct frank_e1000e_legacy_rx_desc	legacy;
+	struct {
+		__le64	buffer_addr;
+		__le64	reserved;
+	} read;
+	struct {
+		__le32	mrq;
+		__le32	rss;
+		__le32	status_error;
+		__le16	length;
+		__le16	vlan;
+	} wb;
+};
+
+/*
+ * Software copy of what each slot holds, so completion and teardown never
+ * read addresses or lengths back from the coherent descriptor ring.
+ */
+struct frank_e1000e_tx_buffer {
+	struct sk_buff	*skb;		/* NULL once copied to the bounce buffer */
+	dma_addr_t		dma;
+	unsigned int	length;		/* Zero when the slot is free */
+	unsigned long	time_stamp;
+};
+
+struct frank_e1000e_rx_buffer {
+	struct sk_buff	*skb;
+	dma_addr_t		dma;
+};
+
+/* Updated from the RX NAPI poll only */
+struct frank_e1000e_rx_stats {
+	u64_stats_t				packets;
+	u64_stats_t				bytes;
+	u64_stats_t				alloc_fail;
+	u64_stats_t				csum_bad;
+	struct u64_stats_sync	syncp;
+};
+
+/* Updated from the TX completion path only */
+struct frank_e1000e_tx_stats {
+	u64_stats_t				packets;
+	u64_stats_t				bytes;
+	u64_stats_t				wake;
+	struct u64_stats_sync	syncp;
+};
+
+/* Updated from ndo_start_xmit only, under the TX queue lock */
+struct frank_e1000e_xmit_stats {
+	u64_stats_t				stop;
+	u64_stats_t				errors;
+	struct u64_stats_sync	syncp;
+};
+
+/*
+ * Each ring starts with the fields fixed at probe, then one cache line per
+ * writer. On TX the producer (ndo_start_xmit) and the consumer (completion)
+ * run on different CPUs and must not bounce each other's line. RX only
+ * has the NAPI poll as writer so it needs a single hot section.
+ */
+struct frank_e1000e_tx_ring {
+	struct frank_e1000e_tx_desc		*desc;
+	struct frank_e1000e_tx_buffer	*buffer_info;
+	dma_addr_t						dma;
+	unsigned int					count;
+	unsigned int					copybreak;
+	u8								*bounce;
+	dma_addr_t						bounce_dma;
+	/* Queue number, also the netdev TX queue it backs */
+	unsigned int					index;
+	u32								tdt_reg;
+
+	/* Producer, written by ndo_start_xmit */
+	unsigned int					tail ____cacheline_aligned_in_smp;
+	struct frank_e1000e_xmit_stats	xmit_stats;
+
+	/* Consumer, written by TX completion and the TX vector */
+	unsigned int					head ____cacheline_aligned_in_smp;
+	u64								irqs;
+	u64								mmio_reads;
+	struct frank_e1000e_tx_stats	stats;
+};
+
+struct frank_e1000e_rx_ring {
+	union frank_e1000e_rx_desc		*desc;
+	struct frank_e1000e_rx_buffer	*buffer_info;
+	dma_addr_t						dma;
+	unsigned int					count;
+	unsigned int					copybreak;
+	/* Extended descriptors with the RSS hash, PCIe parts only */
+	bool							ext;
+	/* Node of the CPU the RX vector runs on, for the buffers posted at open */
+	int								numa_node;
+
+	/* Next slot to check for DD, and the last slot handed to the NIC */
+	unsigned int					next_to_clean ____cacheline_aligned_in_smp;
+	unsigned int					tail;
+	u64								irqs;
+	u64								mmio_reads;
+	struct frank_e1000e_rx_stats	stats;
+};
+
+#ifdef CONFIG_SMP
+/* The probe-time fields must fit the first line, ahead of the hot ones */
+static_assert(offsetof(struct frank_e1000e_tx_ring, tail) == SMP_CACHE_BYTES);
+static_assert(offsetof(struct frank_e1000e_tx_ring, head) % SMP_CACHE_BYTES == 0);
+static_assert(offsetof(struct frank_e1000e_rx_ring, next_to_clean) == SMP_CACHE_BYTES);
+#endif
+
 struct frank_e1000e_adapter {
+	/* Read mostly, used on every interrupt and packet */
 	struct net_device		*netdev;
 	struct pci_dev			*pci;
 	struct frank_e1000e_hw	*hw;
+	unsigned long	state;
+	/* IMS bits re-armed once the RX NAPI poll completes */
+	u32								rx_ims;
+	/* IMS bits re-armed once the TX NAPI poll completes */
+	u32								tx_ims;
+	/* IMS bits set when the interface comes up or a single vector poll ends */
+	u32								ims;
+	/* ICR bits proving a single vector interrupt was raised by us */
+	u32								icr_asserted;
+	/* Single vector: reading ICR masks the device, no IMC write needed */
+	bool							icr_auto_mask;
+	bool	msi_enabled;
+	bool	msix_enabled;
 
+	struct frank_e1000e_tx_ring		tx_ring[FRANK_E1000E_MAX_TX_QUEUES];
+	struct frank_e1000e_rx_ring		rx_ring;
+	unsigned int					num_tx_queues;
+	struct napi_struct				tx_napi;
+	struct napi_struct				rx_napi;
+
+	/* Everything below is configuration or slow path */
 	u8		mac_address[6];
 	u32		msg_enable;
 
-	struct frank_e1000e_tx_desc		*tx_ring;
-	dma_addr_t						tx_ring_dma;
-	unsigned int					tx_ring_size;
-	unsigned int					tx_head;
-	unsigned int					tx_tail;
-	struct sk_buff					**tx_skb;
-
-	struct frank_e1000e_legacy_rx_desc	*rx_ring;
-	dma_addr_t						rx_ring_dma;
-	unsigned int					rx_ring_size;
-	unsigned int					rx_head;
-	unsigned int					rx_tail;
-	struct sk_buff					**rx_skb;
-
-	bool	msi_enabled;
-	
+	/* Read once at probe, serves the MAC address and ethtool -e */
+	u16		nvm[FRANK_E1000E_NVM_WORDS];
+
+	/* Descriptor thresholds and RX delay timers, see ethtool -C */
+	u32		rx_pthresh;
+	u32		rx_hthresh;
+	u32		rx_wthresh;
+	u32		tx_pthresh;
+	u32		tx_hthresh;
+	u32		tx_wthresh;
+	u32		rx_delay_us;
+	u32		rx_abs_delay_us;
+
+	/*
+	 * 802.3x flow control, requested and resolved against the partner.
+	 * fc_lock covers these fields, the MDIC sequences and the FC registers,
+	 * link_task and ethtool both get here.
+	 */
+	struct mutex	fc_lock;
+	bool	fc_autoneg;
+	bool	fc_rx_pause;
+	bool	fc_tx_pause;
+	bool	fc_rx_active;
+	bool	fc_tx_active;
+	u32		fc_high_water;
+	u32		fc_low_water;
+
+	/* RX share of the packet buffer in KB, the rest goes to TX */
+	u32		rx_pba_kb;
+
+	/* Relaxed Ordering on RX data writes, see relaxed_ordering */
+	bool	relaxed_ordering;
+
+	/* TARC arbitration counts per queue while mqprio is offloaded */
+	bool	tx_prio;
+	u32		tx_weight[FRANK_E1000E_MAX_TX_QUEUES];
+
+	/* Runtime resumes and how long bringing the MAC back took, see ethtool -S */
+	u64		pm_resumes;
+	u64		pm_resume_last_us;
+	u64		pm_resume_max_us;
+
+	/* In-place resets after a TX hang, and how long the last one took */
+	u64		tx_timeouts;
+	u64		resets;
+	u64		reset_last_us;
+	/* Queue the last TX timeout fired on, handed to the health reporter */
+	unsigned int	tx_hang_queue;
+
+	struct devlink					*devlink;
+	struct devlink_health_reporter	*tx_reporter;
+
+	/* Interrupts per vector, see ethtool -S. Only written by their handler */
+	u64		other_irqs;
+	u64		legacy_irqs;
+
+	/* Poll mode: ring servicing period, zero when interrupt driven */
+	ktime_t							poll_interval;
+	struct hrtimer					poll_timer;
+
+	struct work_struct				link_task;
+	struct work_struct				reset_task;
+	/* Reset asked for by "devlink health recover", which holds devl_lock */
+	struct work_struct				restart_task;
 };
 
 static inline void frank_e1000e_writel(struct frank_e1000e_hw *hw, u32 reg, u32 val)
@@ -263,10 +662,75 @@ static inline void frank_e1000e_writel(struct frank_e1000e_hw *hw, u32 reg, u32
 	writel(val, hw->hw_addr + reg);
 }
 
+/*
+ * Charged for every MMIO read issued on this CPU while a queue vector's
+ * handler or NAPI poll runs. Those paths should not read anything at all,
+ * rx_irq_mmio_reads and tx_irq_mmio_reads in ethtool -S keep them honest.
+ */
+DECLARE_PER_CPU(u64 *, frank_e1000e_mmio_reads);
+
 static inline u32 frank_e1000e_readl(struct frank_e1000e_hw *hw, u32 reg)
 {
+	u64 *reads = this_cpu_read(frank_e1000e_mmio_reads);
+
+	if (unlikely(reads))
+		(*reads)++;
+
 	return readl(hw->hw_addr + reg);
 }
 
+/* Nests, the RX vector may fire in the middle of the TX poll and vice versa */
+static inline u64 *frank_e1000e_mmio_reads_begin(u64 *reads)
+{
+	return this_cpu_xchg(frank_e1000e_mmio_reads, reads);
+}
+
+static inline void frank_e1000e_mmio_reads_end(u64 *prev)
+{
+	this_cpu_write(frank_e1000e_mmio_reads, prev);
+}
+
+/* One slot always stays empty so a full ring never looks like an empty one */
+static inline unsigned int frank_e1000e_tx_unused(struct frank_e1000e_tx_ring *tx_ring)
+{
+	return (tx_ring->head + tx_ring->count - tx_ring->tail - 1) % tx_ring->count;
+}
+
+void frank_e1000e_set_ethtool_ops(struct net_device *netdev);
+void frank_e1000e_up(struct frank_e1000e_adapter *adapter);
+void frank_e1000e_down(struct frank_e1000e_adapter *adapter);
+int frank_e1000e_alloc_rx_buffers(struct frank_e1000e_adapter *adapter);
+void frank_e1000e_free_rx_buffers(struct frank_e1000e_adapter *adapter);
+int frank_e1000e_pm_get(struct frank_e1000e_adapter *adapter);
+void frank_e1000e_pm_put(struct frank_e1000e_adapter *adapter);
+void frank_e1000e_reinit(struct frank_e1000e_adapter *adapter);
+
+#if IS_ENABLED(CONFIG_NET_DEVLINK)
+int frank_e1000e_devlink_init(struct frank_e1000e_adapter *adapter);
+void frank_e1000e_devlink_register(struct frank_e1000e_adapter *adapter);
+void frank_e1000e_devlink_unregister(struct frank_e1000e_adapter *adapter);
+void frank_e1000e_devlink_tx_report(struct frank_e1000e_adapter *adapter,
+		unsigned int queue);
+#else
+static inline int frank_e1000e_devlink_init(struct frank_e1000e_adapter *adapter)
+{
+	return 0;
+}
+
+static inline void frank_e1000e_devlink_register(struct frank_e1000e_adapter *adapter) {}
+static inline void frank_e1000e_devlink_unregister(struct frank_e1000e_adapter *adapter) {}
+
+/* Without devlink there is nothing to dump to, just recover */
+static inline void frank_e1000e_devlink_tx_report(struct frank_e1000e_adapter *adapter,
+		unsigned int queue)
+{
+	frank_e1000e_reinit(adapter);
+}
+#endif
+void frank_e1000e_config_tx_thresholds(struct frank_e1000e_adapter *adapter);
+void frank_e1000e_config_tx_arb(struct frank_e1000e_adapter *adapter);
+void frank_e1000e_config_rx_thresholds(struct frank_e1000e_adapter *adapter);
+void frank_e1000e_config_fc(struct frank_e1000e_adapter *adapter);
+int frank_e1000e_setup_fc_autoneg(struct frank_e1000e_adapter *adapter);
 
 #endif /*_FRANK_E1000E_H*/
\ No newline at end of file
@@ -0,0 +1,179 @@
+#include "frank_e1000e.h"
+
+static const struct devlink_ops frank_e1000e_devlink_ops = {
+};
+
+static void frank_e1000e_fmsg_tx_desc(struct devlink_fmsg *fmsg,
+		struct frank_e1000e_tx_ring *tx_ring, unsigned int i)
+{
+	struct frank_e1000e_tx_desc *desc = &tx_ring->desc[i];
+	struct frank_e1000e_tx_buffer *buffer_info = &tx_ring->buffer_info[i];
+
+	devlink_fmsg_obj_nest_start(fmsg);
+	devlink_fmsg_u32_pair_put(fmsg, "index", i);
+	devlink_fmsg_u64_pair_put(fmsg, "addr", le64_to_cpu(desc->buffer_addr));
+	devlink_fmsg_u32_pair_put(fmsg, "lower", le32_to_cpu(desc->lower.data));
+	devlink_fmsg_u32_pair_put(fmsg, "upper", le32_to_cpu(desc->upper.data));
+	devlink_fmsg_u32_pair_put(fmsg, "length", buffer_info->length);
+	devlink_fmsg_bool_pair_put(fmsg, "bounced", !buffer_info->skb);
+	devlink_fmsg_u32_pair_put(fmsg, "age_ms",
+			jiffies_to_msecs(jiffies - buffer_info->time_stamp));
+	devlink_fmsg_obj_nest_end(fmsg);
+}
+
+/* Driver and hardware view of one ring, then every descriptor still owned by the NIC */
+static void frank_e1000e_fmsg_tx_ring(struct devlink_fmsg *fmsg,
+		struct frank_e1000e_adapter *adapter,
+		struct frank_e1000e_tx_ring *tx_ring)
+{
+	struct netdev_queue *txq = netdev_get_tx_queue(adapter->netdev,
+						tx_ring->index);
+	struct frank_e1000e_hw *hw = adapter->hw;
+	unsigned int head = READ_ONCE(tx_ring->head);
+	unsigned int tail = READ_ONCE(tx_ring->tail);
+	unsigned int i;
+
+	devlink_fmsg_obj_nest_start(fmsg);
+	devlink_fmsg_u32_pair_put(fmsg, "queue", tx_ring->index);
+	devlink_fmsg_u32_pair_put(fmsg, "head", head);
+	devlink_fmsg_u32_pair_put(fmsg, "tail", tail);
+	devlink_fmsg_u32_pair_put(fmsg, "pending",
+			(tail + tx_ring->count - head) % tx_ring->count);
+	devlink_fmsg_bool_pair_put(fmsg, "stopped", netif_tx_queue_stopped(txq));
+	devlink_fmsg_u32_pair_put(fmsg, "TDH", frank_e1000e_readl(hw,
+			FRANK_E1000E_TXQ_REG(FRANK_E1000E_TDH_REG, tx_ring->index)));
+	devlink_fmsg_u32_pair_put(fmsg, "TDT", frank_e1000e_readl(hw, tx_ring->tdt_reg));
+	devlink_fmsg_u32_pair_put(fmsg, "TXDCTL", frank_e1000e_readl(hw,
+			FRANK_E1000E_TXQ_REG(FRANK_E1000E_TXDCTL0_REG, tx_ring->index)));
+
+	devlink_fmsg_arr_pair_nest_start(fmsg, "descriptors");
+	for (i = head; i != tail; i = (i + 1) % tx_ring->count)
+		frank_e1000e_fmsg_tx_desc(fmsg, tx_ring, i);
+	devlink_fmsg_arr_pair_nest_end(fmsg);
+
+	devlink_fmsg_obj_nest_end(fmsg);
+}
+
+/*
+ * Called with the hung queue as context from frank_e1000e_devlink_tx_report(),
+ * or without one when user space asks for a dump and none is stored.
+ */
+static int frank_e1000e_tx_reporter_dump(struct devlink_health_reporter *reporter,
+		struct devlink_fmsg *fmsg, void *priv_ctx,
+		struct netlink_ext_ack *extack)
+{
+	struct frank_e1000e_adapter *adapter = devlink_health_reporter_priv(reporter);
+	struct frank_e1000e_hw *hw = adapter->hw;
+	unsigned int i;
+	int ret;
+
+	/* The interface may be down and the device in D3hot */
+	ret = frank_e1000e_pm_get(adapter);
+	if (ret)
+		return ret;
+
+	if (priv_ctx)
+		devlink_fmsg_u32_pair_put(fmsg, "hung_queue", *(unsigned int *)priv_ctx);
+
+	devlink_fmsg_pair_nest_start(fmsg, "registers");
+	devlink_fmsg_obj_nest_start(fmsg);
+	devlink_fmsg_u32_pair_put(fmsg, "CTRL",
+			frank_e1000e_readl(hw, FRANK_E1000E_CTRL_REG));
+	devlink_fmsg_u32_pair_put(fmsg, "STATUS",
+			frank_e1000e_readl(hw, FRANK_E1000E_STATUS_REG));
+	devlink_fmsg_u32_pair_put(fmsg, "TCTL",
+			frank_e1000e_readl(hw, FRANK_E1000E_TCTL_REG));
+	devlink_fmsg_u32_pair_put(fmsg, "IMS",
+			frank_e1000e_readl(hw, FRANK_E1000E_IMS_REG));
+	devlink_fmsg_obj_nest_end(fmsg);
+	devlink_fmsg_pair_nest_end(fmsg);
+
+	devlink_fmsg_arr_pair_nest_start(fmsg, "rings");
+	for (i = 0; i < adapter->num_tx_queues; i++)
+		frank_e1000e_fmsg_tx_ring(fmsg, adapter, &adapter->tx_ring[i]);
+	devlink_fmsg_arr_pair_nest_end(fmsg);
+
+	frank_e1000e_pm_put(adapter);
+
+	return 0;
+}
+
+/*
+ * A report from the reset task carries the hung queue and holds no devlink
+ * lock, so it can take RTNL right away. "devlink health recover" comes in
+ * with devl_lock held, and RTNL nests outside it, so that reset is queued.
+ */
+static int frank_e1000e_tx_reporter_recover(struct devlink_health_reporter *reporter,
+		void *priv_ctx, struct netlink_ext_ack *extack)
+{
+	struct frank_e1000e_adapter *adapter = devlink_health_reporter_priv(reporter);
+
+	if (priv_ctx)
+		frank_e1000e_reinit(adapter);
+	else
+		schedule_work(&adapter->restart_task);
+
+	return 0;
+}
+
+static const struct devlink_health_reporter_ops frank_e1000e_tx_reporter_ops = {
+	.name = "tx",
+	.dump = frank_e1000e_tx_reporter_dump,
+	.recover = frank_e1000e_tx_reporter_recover,
+};
+
+/*
+ * Dumps the hung ring and, unless auto recovery was turned off with
+ * "devlink health set", resets the interface. Sleeps, so it runs from
+ * the reset task rather than from ndo_tx_timeout.
+ */
+void frank_e1000e_devlink_tx_report(struct frank_e1000e_adapter *adapter,
+		unsigned int queue)
+{
+	devlink_health_report(adapter->tx_reporter, "TX timeout", &queue);
+}
+
+static void frank_e1000e_devlink_free(void *data)
+{
+	struct frank_e1000e_adapter *adapter = data;
+
+	devlink_health_reporter_destroy(adapter->tx_reporter);
+	devlink_free(adapter->devlink);
+}
+
+int frank_e1000e_devlink_init(struct frank_e1000e_adapter *adapter)
+{
+	struct pci_dev *pdev = adapter->pci;
+	struct device *dev = &pdev->dev;
+	struct devlink *devlink;
+
+	/* The reporter carries the adapter, the instance needs no private area */
+	devlink = devlink_alloc(&frank_e1000e_devlink_ops, 0, dev);
+	if (!devlink) {
+		pci_err(pdev, "Failed to alloc devlink\n");
+		return -ENOMEM;
+	}
+
+	adapter->tx_reporter = devlink_health_reporter_create(devlink,
+					&frank_e1000e_tx_reporter_ops, 0, adapter);
+	if (IS_ERR(adapter->tx_reporter)) {
+		pci_err(pdev, "Failed to create tx health reporter\n");
+		devlink_free(devlink);
+		return PTR_ERR(adapter->tx_reporter);
+	}
+
+	adapter->devlink = devlink;
+
+	/* Runs after remove(), which has already unregistered the instance */
+	return devm_add_action_or_reset(dev, frank_e1000e_devlink_free, adapter);
+}
+
+void frank_e1000e_devlink_register(struct frank_e1000e_adapter *adapter)
+{
+	devlink_register(adapter->devlink);
+}
+
+void frank_e1000e_devlink_unregister(struct frank_e1000e_adapter *adapter)
+{
+	devlink_unregister(adapter->devlink);
+}
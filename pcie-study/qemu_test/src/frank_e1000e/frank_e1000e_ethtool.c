@@ -0,0 +1,257 @@
+#include "frank_e1000e.h"
+
+struct frank_e1000e_stat {
+	char	name[ETH_GSTRING_LEN];
+	size_t	offset;
+};
+
+#define FRANK_E1000E_STAT(_name, _field) { \
+	.name = _name, \
+	.offset = offsetof(struct frank_e1000e_adapter, _field), \
+}
+
+static const struct frank_e1000e_stat frank_e1000e_gstrings_stats[] = {
+	FRANK_E1000E_STAT("pm_resumes", pm_resumes),
+	FRANK_E1000E_STAT("pm_resume_last_us", pm_resume_last_us),
+	FRANK_E1000E_STAT("pm_resume_max_us", pm_resume_max_us),
+	FRANK_E1000E_STAT("tx_timeouts", tx_timeouts),
+	FRANK_E1000E_STAT("resets", resets),
+	FRANK_E1000E_STAT("reset_last_us", reset_last_us),
+	FRANK_E1000E_STAT("rx_irqs", rx_ring.irqs),
+	FRANK_E1000E_STAT("tx_irqs", tx_ring[0].irqs),
+	FRANK_E1000E_STAT("rx_irq_mmio_reads", rx_ring.mmio_reads),
+	FRANK_E1000E_STAT("tx_irq_mmio_reads", tx_ring[0].mmio_reads),
+	FRANK_E1000E_STAT("other_irqs", other_irqs),
+	FRANK_E1000E_STAT("legacy_irqs", legacy_irqs),
+};
+
+#define FRANK_E1000E_STATS_LEN	ARRAY_SIZE(frank_e1000e_gstrings_stats)
+
+static void frank_e1000e_get_drvinfo(struct net_device *netdev,
+		struct ethtool_drvinfo *drvinfo)
+{
+	struct frank_e1000e_adapter *adapter = netdev->ml_priv;
+
+	strscpy(drvinfo->driver, DRIVER_NAME, sizeof(drvinfo->driver));
+	strscpy(drvinfo->version, DRIVER_VERSION, sizeof(drvinfo->version));
+	strscpy(drvinfo->bus_info, pci_name(adapter->pci),
+			sizeof(drvinfo->bus_info));
+}
+
+static int frank_e1000e_get_eeprom_len(struct net_device *netdev)
+{
+	return FRANK_E1000E_NVM_WORDS * sizeof(u16);
+}
+
+/* Served from the shadow read at probe, the NVM itself is not touched */
+static int frank_e1000e_get_eeprom(struct net_device *netdev,
+		struct ethtool_eeprom *eeprom, u8 *bytes)
+{
+	struct frank_e1000e_adapter *adapter = netdev->ml_priv;
+	u32 i;
+
+	if (!eeprom->len)
+		return -EINVAL;
+
+	eeprom->magic = adapter->hw->vendor_id | (adapter->hw->device_id << 16);
+
+	/* The NVM is little endian, low byte of each word first */
+	for (i = 0; i < eeprom->len; i++) {
+		u32 off = eeprom->offset + i;
+
+		bytes[i] = adapter->nvm[off / 2] >> ((off & 1) * 8);
+	}
+
+	return 0;
+}
+
+/*
+ * rx-usecs drives the RX packet delay timer (RDTR), rx-usecs-irq the
+ * absolute one (RADV), rx-frames and tx-frames the descriptor write-back
+ * thresholds. The prefetch/host thresholds are only module parameters.
+ */
+static int frank_e1000e_get_coalesce(struct net_device *netdev,
+		struct ethtool_coalesce *ec,
+		struct kernel_ethtool_coalesce *kernel_coal,
+		struct netlink_ext_ack *extack)
+{
+	struct frank_e1000e_adapter *adapter = netdev->ml_priv;
+
+	ec->rx_coalesce_usecs = adapter->rx_delay_us;
+	ec->rx_coalesce_usecs_irq = adapter->rx_abs_delay_us;
+	ec->rx_max_coalesced_frames = adapter->rx_wthresh;
+	ec->tx_max_coalesced_frames = adapter->tx_wthresh;
+
+	return 0;
+}
+
+static int frank_e1000e_set_coalesce(struct net_device *netdev,
+		struct ethtool_coalesce *ec,
+		struct kernel_ethtool_coalesce *kernel_coal,
+		struct netlink_ext_ack *extack)
+{
+	struct frank_e1000e_adapter *adapter = netdev->ml_priv;
+
+	if (ec->rx_coalesce_usecs > FRANK_E1000E_DELAY_MAX_USECS ||
+		ec->rx_coalesce_usecs_irq > FRANK_E1000E_DELAY_MAX_USECS) {
+		NL_SET_ERR_MSG_MOD(extack, "rx-usecs/rx-usecs-irq out of range");
+		return -EINVAL;
+	}
+
+	if (!ec->rx_max_coalesced_frames ||
+		ec->rx_max_coalesced_frames > FRANK_E1000E_DCTL_THRESH_MAX ||
+		!ec->tx_max_coalesced_frames ||
+		ec->tx_max_coalesced_frames > FRANK_E1000E_DCTL_THRESH_MAX) {
+		NL_SET_ERR_MSG_MOD(extack, "rx-frames/tx-frames must be 1-63");
+		return -EINVAL;
+	}
+
+	adapter->rx_delay_us = ec->rx_coalesce_usecs;
+	adapter->rx_abs_delay_us = ec->rx_coalesce_usecs_irq;
+	adapter->rx_wthresh = ec->rx_max_coalesced_frames;
+	adapter->tx_wthresh = ec->tx_max_coalesced_frames;
+
+	frank_e1000e_config_rx_thresholds(adapter);
+	frank_e1000e_config_tx_thresholds(adapter);
+
+	return 0;
+}
+
+static void frank_e1000e_get_pauseparam(struct net_device *netdev,
+		struct ethtool_pauseparam *pause)
+{
+	struct frank_e1000e_adapter *adapter = netdev->ml_priv;
+
+	mutex_lock(&adapter->fc_lock);
+	pause->autoneg = adapter->fc_autoneg;
+	pause->rx_pause = adapter->fc_rx_pause;
+	pause->tx_pause = adapter->fc_tx_pause;
+	mutex_unlock(&adapter->fc_lock);
+}
+
+static int frank_e1000e_set_pauseparam(struct net_device *netdev,
+		struct ethtool_pauseparam *pause)
+{
+	struct frank_e1000e_adapter *adapter = netdev->ml_priv;
+	int ret = 0;
+
+	mutex_lock(&adapter->fc_lock);
+
+	adapter->fc_autoneg = !!pause->autoneg;
+	adapter->fc_rx_pause = !!pause->rx_pause;
+	adapter->fc_tx_pause = !!pause->tx_pause;
+
+	/* The new setting is resolved on the link up that follows */
+	if (adapter->fc_autoneg) {
+		ret = frank_e1000e_setup_fc_autoneg(adapter);
+	} else {
+		adapter->fc_rx_active = adapter->fc_rx_pause;
+		adapter->fc_tx_active = adapter->fc_tx_pause;
+		frank_e1000e_config_fc(adapter);
+	}
+
+	mutex_unlock(&adapter->fc_lock);
+
+	return ret;
+}
+
+static int frank_e1000e_get_tunable(struct net_device *netdev,
+		const struct ethtool_tunable *tuna, void *data)
+{
+	struct frank_e1000e_adapter *adapter = netdev->ml_priv;
+
+	switch (tuna->id) {
+	case ETHTOOL_RX_COPYBREAK:
+		*(u32 *)data = adapter->rx_ring.copybreak;
+		return 0;
+	case ETHTOOL_TX_COPYBREAK:
+		*(u32 *)data = adapter->tx_ring[0].copybreak;
+		return 0;
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
+/* Both thresholds are sampled per packet, no need to stop the rings */
+static int frank_e1000e_set_tunable(struct net_device *netdev,
+		const struct ethtool_tunable *tuna, const void *data)
+{
+	struct frank_e1000e_adapter *adapter = netdev->ml_priv;
+	u32 val = *(const u32 *)data;
+	unsigned int i;
+
+	switch (tuna->id) {
+	case ETHTOOL_RX_COPYBREAK:
+		if (val > FRANK_E1000E_RX_COPYBREAK_MAX)
+			return -EINVAL;
+		WRITE_ONCE(adapter->rx_ring.copybreak, val);
+		return 0;
+	case ETHTOOL_TX_COPYBREAK:
+		if (val > FRANK_E1000E_TX_BOUNCE_SIZE)
+			return -EINVAL;
+		for (i = 0; i < adapter->num_tx_queues; i++)
+			WRITE_ONCE(adapter->tx_ring[i].copybreak, val);
+		return 0;
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
+static int frank_e1000e_get_sset_count(struct net_device *netdev, int sset)
+{
+	switch (sset) {
+	case ETH_SS_STATS:
+		return FRANK_E1000E_STATS_LEN;
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
+static void frank_e1000e_get_strings(struct net_device *netdev, u32 sset,
+		u8 *data)
+{
+	int i;
+
+	if (sset != ETH_SS_STATS)
+		return;
+
+	for (i = 0; i < FRANK_E1000E_STATS_LEN; i++)
+		ethtool_puts(&data, frank_e1000e_gstrings_stats[i].name);
+}
+
+static void frank_e1000e_get_ethtool_stats(struct net_device *netdev,
+		struct ethtool_stats *stats, u64 *data)
+{
+	struct frank_e1000e_adapter *adapter = netdev->ml_priv;
+	int i;
+
+	for (i = 0; i < FRANK_E1000E_STATS_LEN; i++)
+		data[i] = *(u64 *)((char *)adapter +
+				frank_e1000e_gstrings_stats[i].offset);
+}
+
+/* The ethtool core keeps the PCI device resumed around every op */
+static const struct ethtool_ops frank_e1000e_ethtool_ops = {
+	.supported_coalesce_params = ETHTOOL_COALESCE_RX_USECS |
+				ETHTOOL_COALESCE_RX_USECS_IRQ |
+				ETHTOOL_COALESCE_RX_MAX_FRAMES |
+				ETHTOOL_COALESCE_TX_MAX_FRAMES,
+	.get_drvinfo = frank_e1000e_get_drvinfo,
+	.get_link = ethtool_op_get_link,
+	.get_eeprom_len = frank_e1000e_get_eeprom_len,
+	.get_eeprom = frank_e1000e_get_eeprom,
+	.get_coalesce = frank_e1000e_get_coalesce,
+	.set_coalesce = frank_e1000e_set_coalesce,
+	.get_pauseparam = frank_e1000e_get_pauseparam,
+	.set_pauseparam = frank_e1000e_set_pauseparam,
+	.get_sset_count = frank_e1000e_get_sset_count,
+	.get_strings = frank_e1000e_get_strings,
+	.get_ethtool_stats = frank_e1000e_get_ethtool_stats,
+	.get_tunable = frank_e1000e_get_tunable,
+	.set_tunable = frank_e1000e_set_tunable,
+};
+
+void frank_e1000e_set_ethtool_ops(struct net_device *netdev)
+{
+	netdev->ethtool_ops = &frank_e1000e_ethtool_ops;
+}
@@ -1,5 +1,90 @@
 #include "frank_e1000e.h"
 
+static unsigned int rx_copybreak = FRANK_E1000E_RX_COPYBREAK_DEFAULT;
+module_param(rx_copybreak, uint, 0444);
+MODULE_PARM_DESC(rx_copybreak,
+	"Frames shorter than this are copied and their RX buffer recycled in place");
+
+static unsigned int tx_copybreak = FRANK_E1000E_TX_COPYBREAK_DEFAULT;
+module_param(tx_copybreak, uint, 0444);
+MODULE_PARM_DESC(tx_copybreak,
+	"Frames up to this size are copied into a pre-mapped buffer instead of mapped (max 256)");
+
+static unsigned int rx_pthresh = FRANK_E1000E_RX_PTHRESH_DEFAULT;
+module_param(rx_pthresh, uint, 0444);
+MODULE_PARM_DESC(rx_pthresh, "RX descriptor prefetch threshold (0-63)");
+
+static unsigned int rx_hthresh = FRANK_E1000E_RX_HTHRESH_DEFAULT;
+module_param(rx_hthresh, uint, 0444);
+MODULE_PARM_DESC(rx_hthresh, "RX descriptor host threshold (0-63)");
+
+static unsigned int rx_wthresh = FRANK_E1000E_RX_WTHRESH_DEFAULT;
+module_param(rx_wthresh, uint, 0444);
+MODULE_PARM_DESC(rx_wthresh,
+	"RX descriptor write-back threshold (1-63), only used while rx_delay_us is set");
+
+static unsigned int tx_pthresh = FRANK_E1000E_TX_PTHRESH_DEFAULT;
+module_param(tx_pthresh, uint, 0444);
+MODULE_PARM_DESC(tx_pthresh, "TX descriptor prefetch threshold (0-63)");
+
+static unsigned int tx_hthresh = FRANK_E1000E_TX_HTHRESH_DEFAULT;
+module_param(tx_hthresh, uint, 0444);
+MODULE_PARM_DESC(tx_hthresh, "TX descriptor host threshold (0-63)");
+
+static unsigned int tx_wthresh = FRANK_E1000E_TX_WTHRESH_DEFAULT;
+module_param(tx_wthresh, uint, 0444);
+MODULE_PARM_DESC(tx_wthresh, "TX descriptor write-back threshold (1-63)");
+
+static unsigned int rx_delay_us = FRANK_E1000E_RX_DELAY_DEFAULT;
+module_param(rx_delay_us, uint, 0444);
+MODULE_PARM_DESC(rx_delay_us, "RX packet delay timer (RDTR) in usecs, 0 disables");
+
+static unsigned int rx_abs_delay_us = FRANK_E1000E_RX_ABS_DELAY_DEFAULT;
+module_param(rx_abs_delay_us, uint, 0444);
+MODULE_PARM_DESC(rx_abs_delay_us, "RX absolute delay timer (RADV) in usecs, 0 disables");
+
+static unsigned int fc_high_water;
+module_param(fc_high_water, uint, 0444);
+MODULE_PARM_DESC(fc_high_water,
+	"RX FIFO fill in bytes that sends XOFF, 0 derives it from the RX packet buffer");
+
+static unsigned int fc_low_water;
+module_param(fc_low_water, uint, 0444);
+MODULE_PARM_DESC(fc_low_water,
+	"RX FIFO fill in bytes that sends XON, 0 derives it from the high watermark");
+
+static unsigned int rx_pba_kb;
+module_param(rx_pba_kb, uint, 0444);
+MODULE_PARM_DESC(rx_pba_kb,
+	"KB of the packet buffer given to RX, 0 uses the part's default split");
+
+static unsigned int tx_weight0 = FRANK_E1000E_TX_WEIGHT0_DEFAULT;
+module_param(tx_weight0, uint, 0444);
+MODULE_PARM_DESC(tx_weight0,
+	"TX descriptors fetched from queue 0 (TC0) per arbitration turn under mqprio (1-127)");
+
+static unsigned int tx_weight1 = FRANK_E1000E_TX_WEIGHT1_DEFAULT;
+module_param(tx_weight1, uint, 0444);
+MODULE_PARM_DESC(tx_weight1,
+	"TX descriptors fetched from queue 1 (TC1) per arbitration turn under mqprio (1-127)");
+
+static unsigned int poll_us;
+module_param(poll_us, uint, 0444);
+MODULE_PARM_DESC(poll_us,
+	"Mask the RX/TX interrupts and service the rings from a timer every N usecs (min 10), 0 disables");
+
+static bool relaxed_ordering;
+module_param(relaxed_ordering, bool, 0444);
+MODULE_PARM_DESC(relaxed_ordering,
+	"Let PCIe parts mark RX packet data writes Relaxed Ordering, descriptor write-backs stay ordered");
+
+static int aspm_l1 = -1;
+module_param(aspm_l1, int, 0444);
+MODULE_PARM_DESC(aspm_l1,
+	"ASPM L1 on the link: 0 disable, 1 enable, -1 keep the platform policy");
+
+DEFINE_PER_CPU(u64 *, frank_e1000e_mmio_reads);
+
 static void frank_e1000e_disable_intr(struct frank_e1000e_adapter *adapter)
 {
 	frank_e1000e_writel(adapter->hw, FRANK_E1000E_IMC_REG, FRANK_E1000E_INT_ALL);
@@ -7,7 +92,7 @@ static void frank_e1000e_disable_intr(struct frank_e1000e_adapter *adapter)
 
 static void frank_e1000e_enable_intr(struct frank_e1000e_adapter *adapter)
 {
-	frank_e1000e_writel(adapter->hw, FRANK_E1000E_IMS_REG, FRANK_E1000E_INT_ALL);
+	frank_e1000e_writel(adapter->hw, FRANK_E1000E_IMS_REG, adapter->ims);
 }
 
 static void frank_e1000e_set_link_state(struct frank_e1000e_adapter *adapter, int up)
@@ -24,19 +109,41 @@ static void frank_e1000e_set_link_state(struct frank_e1000e_adapter *adapter, in
 }
 
 
+/* Wake the device if it idled in D3hot, see frank_e1000e_runtime_resume() */
+int frank_e1000e_pm_get(struct frank_e1000e_adapter *adapter)
+{
+	return pm_runtime_resume_and_get(&adapter->pci->dev);
+}
+
+void frank_e1000e_pm_put(struct frank_e1000e_adapter *adapter)
+{
+	struct device *dev = &adapter->pci->dev;
+
+	pm_runtime_mark_last_busy(dev);
+	pm_runtime_put_autosuspend(dev);
+}
+
 static int frank_e1000e_ndo_open(struct net_device *netdev)
 {
 	struct frank_e1000e_adapter *adapter = netdev->ml_priv;
 	struct pci_dev *pdev = adapter->pci;
+	int ret;
 
 	pci_info(pdev, "Network interface opened\n");
 
-	frank_e1000e_enable_intr(adapter);
+	ret = frank_e1000e_pm_get(adapter);
+	if (ret) {
+		pci_err(pdev, "Failed to resume device\n");
+		return ret;
+	}
 
-	frank_e1000e_set_link_state(adapter, 1);
+	ret = frank_e1000e_alloc_rx_buffers(adapter);
+	if (ret) {
+		frank_e1000e_pm_put(adapter);
+		return ret;
+	}
 
-	netif_carrier_on(netdev);
-	netif_start_queue(netdev);
+	frank_e1000e_up(adapter);
 
 	return 0;
 }
@@ -48,28 +155,37 @@ static int frank_e1000e_ndo_stop(struct net_device *netdev)
 
 	pci_info(pdev, "Network interface stop\n");
 
-	frank_e1000e_set_link_state(adapter, 0);
-
-	netif_carrier_off(netdev);
-	frank_e1000e_disable_intr(adapter);
+	frank_e1000e_down(adapter);
+	frank_e1000e_free_rx_buffers(adapter);
 
-	netif_stop_queue(netdev);
+	frank_e1000e_pm_put(adapter);
 
 	return 0;
-} 
+}
+
+#define frank_e1000e_xmit_stats_inc(tx_ring, field) do { \
+	u64_stats_update_begin(&(tx_ring)->xmit_stats.syncp); \
+	u64_stats_inc(&(tx_ring)->xmit_stats.field); \
+	u64_stats_update_end(&(tx_ring)->xmit_stats.syncp); \
+} while (0)
 
 static netdev_tx_t frank_e1000e_ndo_start_xmit(struct sk_buff *skb, struct net_device *netdev)
 {
 	struct frank_e1000e_adapter *adapter = netdev->ml_priv;
 	struct pci_dev *pdev = adapter->pci;
+	u16 qidx = skb_get_queue_mapping(skb);
+	struct frank_e1000e_tx_ring *tx_ring = &adapter->tx_ring[qidx];
+	struct netdev_queue *txq = netdev_get_tx_queue(netdev, qidx);
 	struct frank_e1000e_tx_desc *tx_desc;
+	struct frank_e1000e_tx_buffer *buffer_info;
 	dma_addr_t dma_addr;
 	unsigned int tx_tail;
+	unsigned int length;
 	u32 cmd_flags;
 
-	tx_tail = adapter->tx_tail;
-	if (((tx_tail + 1) % adapter->tx_ring_size) == adapter->tx_head ) {
-		netif_stop_queue(netdev);
+	if (unlikely(!frank_e1000e_tx_unused(tx_ring))) {
+		netif_tx_stop_queue(txq);
+		frank_e1000e_xmit_stats_inc(tx_ring, stop);
 		pci_info(pdev, "TX ring full, stopping queue\n");
 		return NETDEV_TX_BUSY;
 	}
@@ -84,93 +200,381 @@ static netdev_tx_t frank_e1000e_ndo_start_xmit(struct sk_buff *skb, struct net_d
 		return NETDEV_TX_OK;
 	}
 
-	tx_tail = adapter->tx_tail;
-	tx_desc = &adapter->tx_ring[tx_tail];
-
-	dma_addr = dma_map_single(&pdev->dev,
-						skb->data, skb->len, DMA_TO_DEVICE);
-	if (dma_mapping_error(&pdev->dev, dma_addr)) {
-		dev_kfree_skb_any(skb);
-		netdev->stats.tx_errors ++;
-		pci_info(pdev, "Failed to mapping skb\n");
-		return NETDEV_TX_OK;
+	tx_tail = tx_ring->tail;
+	tx_desc = &tx_ring->desc[tx_tail];
+	buffer_info = &tx_ring->buffer_info[tx_tail];
+	length = skb->len;
+
+	if (length <= READ_ONCE(tx_ring->copybreak)) {
+		/* Small frame, skip the map/unmap round trip through the IOMMU */
+		dma_addr = tx_ring->bounce_dma +
+				tx_tail * FRANK_E1000E_TX_BOUNCE_SIZE;
+		skb_copy_bits(skb, 0, tx_ring->bounce +
+				tx_tail * FRANK_E1000E_TX_BOUNCE_SIZE, length);
+		dev_consume_skb_any(skb);
+		skb = NULL;
+	} else {
+		dma_addr = dma_map_single(&pdev->dev,
+							skb->data, length, DMA_TO_DEVICE);
+		if (dma_mapping_error(&pdev->dev, dma_addr)) {
+			dev_kfree_skb_any(skb);
+			frank_e1000e_xmit_stats_inc(tx_ring, errors);
+			pci_info(pdev, "Failed to mapping skb\n");
+			return NETDEV_TX_OK;
+		}
 	}
 
 	tx_desc->buffer_addr = cpu_to_le64(dma_addr);
 
 	cmd_flags = FRANK_E1000E_TXD_CMD_EOP | FRANK_E1000E_TXD_CMD_IFCS |
 				FRANK_E1000E_TXD_CMD_RS;
-	tx_desc->lower.flags.length = cpu_to_le16(skb->len);
+	tx_desc->lower.flags.length = cpu_to_le16(length);
 	tx_desc->lower.flags.cmd = cmd_flags;
 	tx_desc->upper.data = 0;
 
-	adapter->tx_skb[tx_tail] = skb;
+	buffer_info->skb = skb;
+	buffer_info->dma = dma_addr;
+	buffer_info->length = length;
+	buffer_info->time_stamp = jiffies;
 
-	adapter->tx_tail = (tx_tail + 1) % adapter->tx_ring_size;
+	tx_ring->tail = (tx_tail + 1) % tx_ring->count;
 
 	wmb();
 
-	frank_e1000e_writel(adapter->hw, FRANK_E1000E_TDT_REG, adapter->tx_tail);
+	frank_e1000e_writel(adapter->hw, tx_ring->tdt_reg, tx_ring->tail);
+
+	/* Stop before the ring is full so the busy path above stays cold */
+	if (unlikely(!frank_e1000e_tx_unused(tx_ring))) {
+		netif_tx_stop_queue(txq);
+		frank_e1000e_xmit_stats_inc(tx_ring, stop);
+		/* Pairs with the barrier in frank_e1000e_clear_tx_ring() */
+		smp_mb();
+		if (frank_e1000e_tx_unused(tx_ring) >= FRANK_E1000E_TX_WAKE_THRESHOLD)
+			netif_tx_start_queue(txq);
+	}
 
 	return NETDEV_TX_OK;
  } 
 
+static void frank_e1000e_ndo_tx_timeout(struct net_device *netdev,
+		unsigned int txqueue)
+{
+	struct frank_e1000e_adapter *adapter = netdev->ml_priv;
+	struct frank_e1000e_tx_ring *tx_ring = &adapter->tx_ring[txqueue];
+	struct frank_e1000e_tx_buffer *buffer_info =
+				&tx_ring->buffer_info[tx_ring->head];
+
+	pci_warn(adapter->pci, "TX queue %u timed out, head %u tail %u, oldest queued %u ms ago, resetting\n",
+			txqueue, tx_ring->head, tx_ring->tail,
+			buffer_info->length ?
+			jiffies_to_msecs(jiffies - buffer_info->time_stamp) : 0);
+
+	adapter->tx_timeouts++;
+	WRITE_ONCE(adapter->tx_hang_queue, txqueue);
+	schedule_work(&adapter->reset_task);
+}
+
+static void frank_e1000e_fetch_rx_stats(struct frank_e1000e_adapter *adapter,
+		u64 *packets, u64 *bytes, u64 *alloc_fail, u64 *csum_bad)
+{
+	struct frank_e1000e_rx_stats *rx = &adapter->rx_ring.stats;
+	unsigned int start;
+
+	do {
+		start = u64_stats_fetch_begin(&rx->syncp);
+		*packets = u64_stats_read(&rx->packets);
+		*bytes = u64_stats_read(&rx->bytes);
+		*alloc_fail = u64_stats_read(&rx->alloc_fail);
+		*csum_bad = u64_stats_read(&rx->csum_bad);
+	} while (u64_stats_fetch_retry(&rx->syncp, start));
+}
+
+static void frank_e1000e_fetch_tx_stats(struct frank_e1000e_tx_ring *tx_ring,
+		u64 *packets, u64 *bytes, u64 *wake, u64 *stop, u64 *errors)
+{
+	struct frank_e1000e_tx_stats *tx = &tx_ring->stats;
+	struct frank_e1000e_xmit_stats *xmit = &tx_ring->xmit_stats;
+	unsigned int start;
+
+	do {
+		start = u64_stats_fetch_begin(&tx->syncp);
+		*packets = u64_stats_read(&tx->packets);
+		*bytes = u64_stats_read(&tx->bytes);
+		*wake = u64_stats_read(&tx->wake);
+	} while (u64_stats_fetch_retry(&tx->syncp, start));
+
+	do {
+		start = u64_stats_fetch_begin(&xmit->syncp);
+		*stop = u64_stats_read(&xmit->stop);
+		*errors = u64_stats_read(&xmit->errors);
+	} while (u64_stats_fetch_retry(&xmit->syncp, start));
+}
+
+static void frank_e1000e_ndo_get_stats64(struct net_device *netdev,
+		struct rtnl_link_stats64 *stats)
+{
+	struct frank_e1000e_adapter *adapter = netdev->ml_priv;
+	u64 packets, bytes, wake, stop, errors, csum_bad;
+	unsigned int i;
+
+	frank_e1000e_fetch_rx_stats(adapter, &stats->rx_packets,
+			&stats->rx_bytes, &stats->rx_dropped, &csum_bad);
+
+	for (i = 0; i < adapter->num_tx_queues; i++) {
+		frank_e1000e_fetch_tx_stats(&adapter->tx_ring[i], &packets,
+				&bytes, &wake, &stop, &errors);
+		stats->tx_packets += packets;
+		stats->tx_bytes += bytes;
+		stats->tx_errors += errors;
+	}
+}
+
+/* The rings are never reallocated, their counters live as long as the adapter */
+static void frank_e1000e_get_queue_stats_rx(struct net_device *netdev, int idx,
+		struct netdev_queue_stats_rx *stats)
+{
+	struct frank_e1000e_adapter *adapter = netdev->ml_priv;
+
+	frank_e1000e_fetch_rx_stats(adapter, &stats->packets, &stats->bytes,
+			&stats->alloc_fail, &stats->csum_bad);
+}
+
+static void frank_e1000e_get_queue_stats_tx(struct net_device *netdev, int idx,
+		struct netdev_queue_stats_tx *stats)
+{
+	struct frank_e1000e_adapter *adapter = netdev->ml_priv;
+	u64 errors;
+
+	frank_e1000e_fetch_tx_stats(&adapter->tx_ring[idx], &stats->packets, &stats->bytes,
+			&stats->wake, &stats->stop, &errors);
+}
+
+static void frank_e1000e_get_base_stats(struct net_device *netdev,
+		struct netdev_queue_stats_rx *rx,
+		struct netdev_queue_stats_tx *tx)
+{
+	rx->packets = 0;
+	rx->bytes = 0;
+	rx->alloc_fail = 0;
+	rx->csum_bad = 0;
+
+	tx->packets = 0;
+	tx->bytes = 0;
+	tx->stop = 0;
+	tx->wake = 0;
+}
+
+static const struct netdev_stat_ops frank_e1000e_stat_ops = {
+	.get_queue_stats_rx = frank_e1000e_get_queue_stats_rx,
+	.get_queue_stats_tx = frank_e1000e_get_queue_stats_tx,
+	.get_base_stats = frank_e1000e_get_base_stats,
+};
+
+/*
+ * Steer every TX queue to the CPUs the TX vector runs on. Changing the
+ * traffic class setup throws the XPS maps away, so mqprio redoes this too.
+ */
+static void frank_e1000e_set_xps(struct frank_e1000e_adapter *adapter)
+{
+	const struct cpumask *mask;
+	u16 q;
+
+	if (!adapter->msix_enabled)
+		return;
+
+	mask = pci_irq_get_affinity(adapter->pci, FRANK_E1000E_MSIX_TX);
+	if (!mask)
+		return;
+
+	for (q = 0; q < adapter->num_tx_queues; q++)
+		netif_set_xps_queue(adapter->netdev, mask, q);
+}
+
+/*
+ * mqprio hw offload: TC0 gets queue 0 and TC1 queue 1, the TARC weights
+ * then decide how often each queue is served. Removing the qdisc goes
+ * back to equal weights.
+ */
+static int frank_e1000e_setup_mqprio(struct frank_e1000e_adapter *adapter,
+		struct tc_mqprio_qopt_offload *mqprio)
+{
+	struct net_device *netdev = adapter->netdev;
+	struct tc_mqprio_qopt *qopt = &mqprio->qopt;
+	int i;
+
+	if (adapter->num_tx_queues < FRANK_E1000E_NUM_TC)
+		return -EOPNOTSUPP;
+
+	if (!qopt->num_tc) {
+		netdev_reset_tc(netdev);
+		adapter->tx_prio = false;
+		goto out;
+	}
+
+	if (qopt->num_tc != FRANK_E1000E_NUM_TC ||
+		mqprio->mode != TC_MQPRIO_MODE_DCB ||
+		mqprio->shaper != TC_MQPRIO_SHAPER_DCB) {
+		NL_SET_ERR_MSG_MOD(mqprio->extack,
+				"Only 2 traffic classes in dcb mode are supported");
+		return -EOPNOTSUPP;
+	}
+
+	for (i = 0; i < FRANK_E1000E_NUM_TC; i++) {
+		if (qopt->count[i] != 1 || qopt->offset[i] != i) {
+			NL_SET_ERR_MSG_MOD(mqprio->extack,
+					"Queues must be mapped as 1@0 1@1");
+			return -EINVAL;
+		}
+	}
+
+	netdev_set_num_tc(netdev, FRANK_E1000E_NUM_TC);
+	for (i = 0; i < FRANK_E1000E_NUM_TC; i++)
+		netdev_set_tc_queue(netdev, i, 1, i);
+	for (i = 0; i <= TC_BITMASK; i++)
+		netdev_set_prio_tc_map(netdev, i, qopt->prio_tc_map[i]);
+
+	adapter->tx_prio = true;
+	qopt->hw = TC_MQPRIO_HW_OFFLOAD_TCS;
+
+out:
+	frank_e1000e_set_xps(adapter);
+
+	/* A down interface picks the weights up in frank_e1000e_configure_tx() */
+	if (netif_running(netdev))
+		frank_e1000e_config_tx_arb(adapter);
+
+	return 0;
+}
+
+static int frank_e1000e_ndo_setup_tc(struct net_device *netdev,
+		enum tc_setup_type type, void *type_data)
+{
+	switch (type) {
+	case TC_SETUP_QDISC_MQPRIO:
+		return frank_e1000e_setup_mqprio(netdev->ml_priv, type_data);
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
 static const struct net_device_ops frank_e1000e_netdev_ops = {
 	.ndo_open = frank_e1000e_ndo_open,
 	.ndo_stop = frank_e1000e_ndo_stop,
 	.ndo_start_xmit = frank_e1000e_ndo_start_xmit,
+	.ndo_tx_timeout = frank_e1000e_ndo_tx_timeout,
+	.ndo_get_stats64 = frank_e1000e_ndo_get_stats64,
+	.ndo_setup_tc = frank_e1000e_ndo_setup_tc,
 };
 
-static int frank_e1000e_read_eeprom_word(struct frank_e1000e_adapter *adapter,
-		u16 address, u16 *data) 
+/*
+ * EERD has no burst mode, so this is still one transaction per word, but
+ * the whole range goes out back to back and each word completes within a
+ * few microseconds, well below the old 10us poll interval.
+ */
+static int frank_e1000e_read_nvm(struct frank_e1000e_adapter *adapter,
+		u16 offset, u16 words, u16 *data)
 {
+	const struct frank_e1000e_info *info = adapter->hw->info;
 	int ret;
-	u32 val = 0;
-	val &= ~FRANK_E1000E_EERD_ADDR_MASK;
-	val |= FRANK_E1000E_EERD_ADDR(address);
-	val |= FRANK_E1000E_EERD_START;
-	
-	frank_e1000e_writel(adapter->hw, FRANK_E1000E_EERD_REG, val);
-	
-	ret = readl_poll_timeout(adapter->hw->hw_addr + FRANK_E1000E_EERD_REG,
-					val, val & FRANK_E1000E_EERD_DONE,
-					10, FRANK_E1000E_EERD_TIMEOUT);
-	if (ret) {
-		pci_err(adapter->pci, "Read eeprom time out\n");
-		return ret;
+	u16 i;
+	u32 val;
+
+	for (i = 0; i < words; i++) {
+		val = ((offset + i) << info->eerd_addr_shift) | FRANK_E1000E_EERD_START;
+		frank_e1000e_writel(adapter->hw, FRANK_E1000E_EERD_REG, val);
+
+		ret = readl_poll_timeout(adapter->hw->hw_addr + FRANK_E1000E_EERD_REG,
+						val, val & info->eerd_done,
+						FRANK_E1000E_EERD_POLL_US,
+						FRANK_E1000E_EERD_TIMEOUT);
+		if (ret) {
+			pci_err(adapter->pci, "Read eeprom word 0x%x time out\n",
+					offset + i);
+			return ret;
+		}
+
+		data[i] = FRANK_E1000E_EERD_DATA(val);
 	}
 
-	*data = FRANK_E1000E_EERD_DATA(val);
+	return 0;
+}
+
+static int frank_e1000e_init_nvm(struct frank_e1000e_adapter *adapter)
+{
+	ktime_t start = ktime_get();
+	u16 sum = 0;
+	int i, ret;
+
+	ret = frank_e1000e_read_nvm(adapter, 0, FRANK_E1000E_NVM_WORDS,
+			adapter->nvm);
+	if (ret)
+		return ret;
+
+	for (i = 0; i <= FRANK_E1000E_NVM_CHECKSUM; i++)
+		sum += adapter->nvm[i];
+
+	/* Some virtual and development boards ship a blank checksum */
+	if (sum != FRANK_E1000E_NVM_SUM)
+		pci_warn(adapter->pci, "NVM checksum mismatch 0x%04x\n", sum);
+
+	pci_info(adapter->pci, "NVM read %u words in %lld us\n",
+			FRANK_E1000E_NVM_WORDS, ktime_us_delta(ktime_get(), start));
 
 	return 0;
 }
 
-static int frank_e1000e_read_mac_addr(struct frank_e1000e_adapter *adapter)
+static void frank_e1000e_read_mac_addr(struct frank_e1000e_adapter *adapter)
 {
-	int i;
-	int ret;
 	u16 word;
-	
-	for (i = 0; i < 3; i++){
-		ret = frank_e1000e_read_eeprom_word(adapter, i , &word);
-		if (ret) {
-			pci_err(adapter->pci, "Failed to read mac address\n");
-			return ret;
-		}
-		
+	int i;
+
+	for (i = 0; i < 3; i++) {
+		word = adapter->nvm[FRANK_E1000E_NVM_MAC_ADDR + i];
 		adapter->mac_address[i * 2] = word & 0xFF;
 		adapter->mac_address[i * 2 + 1] = (word >> 8) & 0xFF;
 	}
 
-	pci_info(adapter->pci, "MAC address: %02x:%02x:%02x:%02x:%02x:%02x\n",
-			adapter->mac_address[0], adapter->mac_address[1], 
-			adapter->mac_address[2], adapter->mac_address[3],
-			adapter->mac_address[4], adapter->mac_address[5]);
+	pci_info(adapter->pci, "MAC address: %pM\n", adapter->mac_address);
+}
 
-	return 0;
-} 
+/*
+ * Split the packet buffer between the RX and TX FIFOs. TX must be able to
+ * hold two maximum sized frames and RX at least one, so jumbo frames eat
+ * into the RX share. The value only takes effect on the next MAC reset.
+ */
+static void frank_e1000e_config_pba(struct frank_e1000e_adapter *adapter)
+{
+	u32 total, rx, min_rx, min_tx, max_frame;
+
+	total = adapter->hw->info->pba_total_kb;
+	rx = rx_pba_kb ? rx_pba_kb : adapter->hw->info->pba_rx_kb;
+
+	max_frame = adapter->netdev->mtu + ETH_HLEN + ETH_FCS_LEN;
+	min_rx = DIV_ROUND_UP(max_frame, 1024);
+	min_tx = DIV_ROUND_UP((max_frame + sizeof(struct frank_e1000e_tx_desc)) * 2,
+			1024);
+
+	if (total - min(rx, total) < min_tx)
+		rx = total - min_tx;
+	if (rx < min_rx)
+		rx = min_rx;
 
-static void frank_e1000e_sw_reset(struct frank_e1000e_adapter *adapter)
+	if (rx_pba_kb && rx != rx_pba_kb)
+		pci_warn(adapter->pci, "rx_pba_kb %u adjusted to %u\n",
+				rx_pba_kb, rx);
+
+	adapter->rx_pba_kb = rx;
+	frank_e1000e_writel(adapter->hw, FRANK_E1000E_PBA_REG, rx);
+
+	pci_info(adapter->pci, "Packet buffer RX %u KB TX %u KB\n",
+			rx, total - rx);
+}
+
+/*
+ * The reset is split in two so probe can do its software setup while the
+ * MAC is busy resetting and reloading its NVM defaults.
+ */
+static void frank_e1000e_reset_start(struct frank_e1000e_adapter *adapter)
 {
 	u32 val;
 
@@ -178,14 +582,41 @@ static void frank_e1000e_sw_reset(struct frank_e1000e_adapter *adapter)
 	val |= FRANK_E1000E_CTRL_RST;
 
 	frank_e1000e_writel(adapter->hw, FRANK_E1000E_CTRL_REG, val);
+}
+
+static int frank_e1000e_reset_wait(struct frank_e1000e_adapter *adapter)
+{
+	void __iomem *hw_addr = adapter->hw->hw_addr;
+	int ret;
+	u32 val;
+
+	ret = readl_poll_timeout(hw_addr + FRANK_E1000E_CTRL_REG, val,
+				!(val & FRANK_E1000E_CTRL_RST),
+				FRANK_E1000E_RESET_POLL_US, FRANK_E1000E_RESET_TIMEOUT);
+	if (ret) {
+		pci_err(adapter->pci, "MAC reset time out\n");
+		return ret;
+	}
+
+	/* Only the PCIe parts report the end of the NVM auto-load, or have GCR */
+	if (!(adapter->hw->info->flags & FRANK_E1000E_FLAG_PCIE))
+		return 0;
 
-	/* Wait 1 microsecond for reset to complete */
-	usleep_range(1, 10);
+	ret = readl_poll_timeout(hw_addr + FRANK_E1000E_EECD_REG, val,
+				val & FRANK_E1000E_EECD_AUTO_RD,
+				FRANK_E1000E_RESET_POLL_US,
+				FRANK_E1000E_RESET_TIMEOUT);
+	if (ret) {
+		pci_err(adapter->pci, "NVM auto read time out\n");
+		return ret;
+	}
 
 	val = frank_e1000e_readl(adapter->hw, FRANK_E1000E_GCR_REG);
 	val |= FRANK_E1000E_GCR_SW_INIT;
 
 	frank_e1000e_writel(adapter->hw, FRANK_E1000E_GCR_REG, val);
+
+	return 0;
 }
 
 //Init the registers for mac and phy
@@ -200,116 +631,468 @@ static void frank_e1000e_hw_init(struct frank_e1000e_adapter *adapter)
 	val &= ~FRANK_E1000E_CTRL_SLU;
 
 	frank_e1000e_writel(adapter->hw, FRANK_E1000E_CTRL_REG, val);
+
+	/*
+	 * With RO_DIS clear the PCIe parts request Relaxed Ordering for RX
+	 * packet data only. Descriptor write-backs keep strong ordering so
+	 * they can never pass the data they point at.
+	 */
+	if (adapter->hw->info->flags & FRANK_E1000E_FLAG_PCIE) {
+		val = frank_e1000e_readl(adapter->hw, FRANK_E1000E_CTRL_EXT);
+		if (adapter->relaxed_ordering)
+			val &= ~FRANK_E1000E_CTRL_EXT_RO_DIS;
+		else
+			val |= FRANK_E1000E_CTRL_EXT_RO_DIS;
+		frank_e1000e_writel(adapter->hw, FRANK_E1000E_CTRL_EXT, val);
+	}
 }
 
-static int frank_e1000e_init_netdev(struct frank_e1000e_adapter *adapter)
-{	
+static int frank_e1000e_mdic(struct frank_e1000e_adapter *adapter, u32 cmd,
+		u32 *out)
+{
+	u32 val;
+	int ret;
+
+	lockdep_assert_held(&adapter->fc_lock);
+
+	frank_e1000e_writel(adapter->hw, FRANK_E1000E_MDIC_REG, cmd);
+
+	ret = readl_poll_timeout(adapter->hw->hw_addr + FRANK_E1000E_MDIC_REG,
+					val, val & FRANK_E1000E_MDIC_READY,
+					10, FRANK_E1000E_MDIC_TIMEOUT);
+	if (ret || (val & FRANK_E1000E_MDIC_ERROR)) {
+		pci_err(adapter->pci, "MDIC access failed\n");
+		return ret ? ret : -EIO;
+	}
+
+	if (out)
+		*out = val;
+
+	return 0;
+}
+
+static int frank_e1000e_read_phy_reg(struct frank_e1000e_adapter *adapter,
+		u32 reg, u16 *data)
+{
+	u32 val;
+	int ret;
+
+	ret = frank_e1000e_mdic(adapter, FRANK_E1000E_MDIC_REGADD(reg) |
+			FRANK_E1000E_MDIC_PHYADD(FRANK_E1000E_PHY_ADDR) |
+			FRANK_E1000E_MDIC_OP_READ, &val);
+	if (ret)
+		return ret;
+
+	*data = FRANK_E1000E_MDIC_DATA(val);
+
+	return 0;
+}
+
+static int frank_e1000e_write_phy_reg(struct frank_e1000e_adapter *adapter,
+		u32 reg, u16 data)
+{
+	return frank_e1000e_mdic(adapter, FRANK_E1000E_MDIC_DATA(data) |
+			FRANK_E1000E_MDIC_REGADD(reg) |
+			FRANK_E1000E_MDIC_PHYADD(FRANK_E1000E_PHY_ADDR) |
+			FRANK_E1000E_MDIC_OP_WRITE, NULL);
+}
+
+/*
+ * Derive the XOFF/XON watermarks from the RX share of the packet buffer.
+ * XOFF has to leave room for one more full frame that may already be on
+ * the wire when the pause frame goes out, the module parameters included.
+ */
+static void frank_e1000e_fc_watermarks(struct frank_e1000e_adapter *adapter)
+{
+	u32 rx_fifo, max_frame, max_high, high, low;
+
+	rx_fifo = FRANK_E1000E_PBA_RXA(frank_e1000e_readl(adapter->hw,
+					FRANK_E1000E_PBA_REG)) * 1024;
+	max_frame = adapter->netdev->mtu + ETH_HLEN + ETH_FCS_LEN;
+	max_high = max_t(u32, (rx_fifo - max_frame) & FRANK_E1000E_FCRT_MASK,
+			FRANK_E1000E_FCRTH_MIN);
+
+	high = fc_high_water ? fc_high_water : rx_fifo * 9 / 10;
+	high = clamp_t(u32, high & FRANK_E1000E_FCRT_MASK,
+			FRANK_E1000E_FCRTH_MIN, max_high);
+	if (fc_high_water && high != fc_high_water)
+		pci_warn(adapter->pci, "fc_high_water %u adjusted to %u\n",
+				fc_high_water, high);
+
+	/* high is at least FCRTH_MIN, so this never wraps */
+	low = (fc_low_water && fc_low_water < high) ?
+			fc_low_water & FRANK_E1000E_FCRT_MASK : high - 8;
+	if (fc_low_water && low != fc_low_water)
+		pci_warn(adapter->pci, "fc_low_water %u adjusted to %u\n",
+				fc_low_water, low);
+
+	adapter->fc_high_water = high;
+	adapter->fc_low_water = low;
+}
+
+void frank_e1000e_config_fc(struct frank_e1000e_adapter *adapter)
+{
+	u32 val;
+
+	lockdep_assert_held(&adapter->fc_lock);
+
+	frank_e1000e_writel(adapter->hw, FRANK_E1000E_FCAL_REG, FRANK_E1000E_FCAL_VAL);
+	frank_e1000e_writel(adapter->hw, FRANK_E1000E_FCAH_REG, FRANK_E1000E_FCAH_VAL);
+	frank_e1000e_writel(adapter->hw, FRANK_E1000E_FCT_REG, FRANK_E1000E_FCT_VAL);
+	frank_e1000e_writel(adapter->hw, FRANK_E1000E_FCTTV_REG,
+			FRANK_E1000E_FC_PAUSE_TIME);
+
+	/* Zero watermarks keep the MAC from ever sending XOFF */
+	if (adapter->fc_tx_active) {
+		frank_e1000e_writel(adapter->hw, FRANK_E1000E_FCRTL_REG,
+				adapter->fc_low_water | FRANK_E1000E_FCRTL_XONE);
+		frank_e1000e_writel(adapter->hw, FRANK_E1000E_FCRTH_REG,
+				adapter->fc_high_water);
+	} else {
+		frank_e1000e_writel(adapter->hw, FRANK_E1000E_FCRTL_REG, 0);
+		frank_e1000e_writel(adapter->hw, FRANK_E1000E_FCRTH_REG, 0);
+	}
+
+	val = frank_e1000e_readl(adapter->hw, FRANK_E1000E_CTRL_REG);
+	val &= ~(FRANK_E1000E_CTRL_RFCE | FRANK_E1000E_CTRL_TFCE);
+	if (adapter->fc_rx_active)
+		val |= FRANK_E1000E_CTRL_RFCE;
+	if (adapter->fc_tx_active)
+		val |= FRANK_E1000E_CTRL_TFCE;
+	frank_e1000e_writel(adapter->hw, FRANK_E1000E_CTRL_REG, val);
+}
+
+/* Advertise the requested pause abilities and restart autonegotiation */
+int frank_e1000e_setup_fc_autoneg(struct frank_e1000e_adapter *adapter)
+{
+	u16 adv, bmcr;
 	int ret;
+
+	ret = frank_e1000e_read_phy_reg(adapter, MII_ADVERTISE, &adv);
+	if (ret)
+		return ret;
+
+	adv &= ~(ADVERTISE_PAUSE_CAP | ADVERTISE_PAUSE_ASYM);
+	adv |= mii_advertise_flowctrl((adapter->fc_rx_pause ? FLOW_CTRL_RX : 0) |
+			(adapter->fc_tx_pause ? FLOW_CTRL_TX : 0));
+
+	ret = frank_e1000e_write_phy_reg(adapter, MII_ADVERTISE, adv);
+	if (ret)
+		return ret;
+
+	ret = frank_e1000e_read_phy_reg(adapter, MII_BMCR, &bmcr);
+	if (ret)
+		return ret;
+
+	bmcr |= BMCR_ANENABLE | BMCR_ANRESTART;
+
+	return frank_e1000e_write_phy_reg(adapter, MII_BMCR, bmcr);
+}
+
+/* Settle pause usage with the link partner once the link is up */
+static void frank_e1000e_fc_resolve(struct frank_e1000e_adapter *adapter,
+		u32 status)
+{
+	u16 adv, lpa;
+	u8 fc;
+
+	if (adapter->fc_autoneg) {
+		if (!(status & FRANK_E1000E_STATUS_FD) ||
+			frank_e1000e_read_phy_reg(adapter, MII_ADVERTISE, &adv) ||
+			frank_e1000e_read_phy_reg(adapter, MII_LPA, &lpa)) {
+			fc = 0;
+		} else {
+			fc = mii_resolve_flowctrl_fdx(adv, lpa);
+		}
+
+		adapter->fc_rx_active = !!(fc & FLOW_CTRL_RX);
+		adapter->fc_tx_active = !!(fc & FLOW_CTRL_TX);
+	} else {
+		adapter->fc_rx_active = adapter->fc_rx_pause;
+		adapter->fc_tx_active = adapter->fc_tx_pause;
+	}
+
+	frank_e1000e_config_fc(adapter);
+
+	pci_info(adapter->pci, "Flow control RX %s TX %s\n",
+			adapter->fc_rx_active ? "on" : "off",
+			adapter->fc_tx_active ? "on" : "off");
+}
+
+static void frank_e1000e_init_fc(struct frank_e1000e_adapter *adapter)
+{
+	adapter->fc_autoneg = true;
+	adapter->fc_rx_pause = true;
+	adapter->fc_tx_pause = true;
+
+	frank_e1000e_fc_watermarks(adapter);
+
+	mutex_lock(&adapter->fc_lock);
+	frank_e1000e_config_fc(adapter);
+	if (frank_e1000e_setup_fc_autoneg(adapter))
+		pci_warn(adapter->pci, "Failed to advertise pause abilities\n");
+	mutex_unlock(&adapter->fc_lock);
+}
+
+static int frank_e1000e_alloc_netdev(struct frank_e1000e_adapter *adapter)
+{
 	struct net_device *netdev;
 	struct pci_dev *pdev = adapter->pci;
 
-	netdev = alloc_etherdev(0);
+	netdev = alloc_etherdev_mqs(0, adapter->num_tx_queues, 1);
 	if (!netdev) {
 		pci_err(pdev, "Failed to alloc netdev\n");
-		ret = -ENOMEM;
-		goto alloc_etherdev_error;
+		return -ENOMEM;
 	}
 
 	netdev->netdev_ops = &frank_e1000e_netdev_ops;
+	netdev->watchdog_timeo = FRANK_E1000E_TX_TIMEOUT;
+	netdev->stat_ops = &frank_e1000e_stat_ops;
+	netdev->hw_features |= NETIF_F_RXCSUM;
+	if (adapter->rx_ring.ext)
+		netdev->hw_features |= NETIF_F_RXHASH;
+	netdev->features |= netdev->hw_features;
+	frank_e1000e_set_ethtool_ops(netdev);
 	adapter->netdev = netdev;
 	netdev->ml_priv = adapter;
 
 	SET_NETDEV_DEV(netdev, &pdev->dev);
 	netdev->dev.parent = &pdev->dev;
-	
+
+	return 0;
+}
+
+static void frank_e1000e_free_netdev(struct frank_e1000e_adapter *adapter)
+{
+	netif_napi_del(&adapter->rx_napi);
+	netif_napi_del(&adapter->tx_napi);
+	free_netdev(adapter->netdev);
+	adapter->netdev = NULL;
+}
+
+static int frank_e1000e_init_netdev(struct frank_e1000e_adapter *adapter)
+{	
+	int ret;
+	struct net_device *netdev = adapter->netdev;
+	struct pci_dev *pdev = adapter->pci;
+
 	eth_hw_addr_set(netdev, adapter->mac_address);
 
 	ret = register_netdev(netdev);
 	if (ret) {
 		pci_err(pdev, "Failed to register netdev\n");
-		goto register_netdev_error;
+		return ret;
 	}
 
 	return 0;
-
-register_netdev_error:
-	free_netdev(netdev);
-	adapter->netdev = NULL;
-alloc_etherdev_error:
-	return ret;
 }
 
-static void frank_e1000e_clear_tx_ring(struct frank_e1000e_adapter *adapter)
+/*
+ * Reap completed TX descriptors. Stats and the queue wake decision are
+ * applied once per pass rather than per descriptor, and skbs are handed to
+ * napi_consume_skb() so they are freed in bulk at the end of the poll.
+ * Returns true once every completed descriptor has been reclaimed.
+ */
+static bool frank_e1000e_clear_tx_ring(struct frank_e1000e_adapter *adapter,
+		struct frank_e1000e_tx_ring *tx_ring, int budget)
 {
 	struct frank_e1000e_tx_desc *desc;
-	struct net_device *netdev = adapter->netdev;
+	struct netdev_queue *txq = netdev_get_tx_queue(adapter->netdev,
+						tx_ring->index);
 	struct pci_dev *pdev = adapter->pci;
-	unsigned int tx_head = adapter->tx_head;
-	struct sk_buff *skb;
+	unsigned int tx_head = tx_ring->head;
+	struct frank_e1000e_tx_buffer *buffer_info;
 	unsigned int cleaned = 0;
+	unsigned int packets = 0, bytes = 0, wake = 0;
 
-	while((tx_head != adapter->tx_tail)) {
-		desc = &adapter->tx_ring[tx_head];
+	while ((tx_head != tx_ring->tail) &&
+		cleaned < FRANK_E1000E_TX_CLEAN_BUDGET) {
+		desc = &tx_ring->desc[tx_head];
 
 		if ( !(desc->upper.fields.status & FRANK_E1000E_TXD_STAT_DD))
 			break;
 
-		skb = adapter->tx_skb[tx_head];
-		if (skb) {
-			/* Update TX statistics */
-			netdev->stats.tx_packets++;
-			netdev->stats.tx_bytes += skb->len;
-			
-			dma_unmap_single(&pdev->dev, le64_to_cpu(desc->buffer_addr),
-					le16_to_cpu(desc->lower.flags.length),
-					DMA_TO_DEVICE);
-			dev_kfree_skb_irq(skb);
-			adapter->tx_skb[tx_head] = NULL;
+		buffer_info = &tx_ring->buffer_info[tx_head];
+		if (buffer_info->length) {
+			packets++;
+			bytes += buffer_info->length;
+
+			/* Bounced frames were freed at xmit time */
+			if (buffer_info->skb) {
+				dma_unmap_single(&pdev->dev, buffer_info->dma,
+						buffer_info->length, DMA_TO_DEVICE);
+				napi_consume_skb(buffer_info->skb, budget);
+				buffer_info->skb = NULL;
+			}
+			buffer_info->length = 0;
 		}
 
 		desc->upper.fields.status = 0;
-		tx_head = (tx_head + 1) % adapter->tx_ring_size;
+		tx_head = (tx_head + 1) % tx_ring->count;
 		
 		cleaned ++;
 	}
 
-	adapter->tx_head = tx_head;
+	if (!cleaned)
+		return true;
+
+	tx_ring->head = tx_head;
+
+	/* Pairs with the barrier in frank_e1000e_ndo_start_xmit() */
+	smp_mb();
 
-	if (cleaned && netif_queue_stopped(netdev)) {
-		netif_wake_queue(netdev);
-		pci_info(pdev, "TX queue restarted after cleaning %u desc\n",
-			cleaned);
+	if (netif_tx_queue_stopped(txq) &&
+		frank_e1000e_tx_unused(tx_ring) >= FRANK_E1000E_TX_WAKE_THRESHOLD) {
+		netif_tx_wake_queue(txq);
+		wake = 1;
 	}
+
+	u64_stats_update_begin(&tx_ring->stats.syncp);
+	u64_stats_add(&tx_ring->stats.packets, packets);
+	u64_stats_add(&tx_ring->stats.bytes, bytes);
+	u64_stats_add(&tx_ring->stats.wake, wake);
+	u64_stats_update_end(&tx_ring->stats.syncp);
+
+	return cleaned < FRANK_E1000E_TX_CLEAN_BUDGET;
 }
 
-static void frank_e1000e_clear_rx_ring(struct frank_e1000e_adapter *adapter)
+/* Both queues share one vector, every ring gets its full clean budget */
+static bool frank_e1000e_clear_tx_rings(struct frank_e1000e_adapter *adapter,
+		int budget)
 {
-	struct frank_e1000e_legacy_rx_desc *desc;
-	unsigned int head;
-	struct net_device *netdev = adapter->netdev;
-	struct pci_dev *pdev = adapter->pci;
-	unsigned int rx_head;
-	unsigned int next = adapter->rx_tail;
-	struct sk_buff *skb, *new_skb;
-	int completed = 0, cnt = 0;
-	unsigned int size = 0;
-	dma_addr_t dma_addr;
-	
-	rx_head = frank_e1000e_readl(adapter->hw, FRANK_E1000E_RDH0_REG) & GENMASK(15, 0);
-	adapter->rx_head = rx_head;
-	while( (next = ((next + 1) % adapter->rx_ring_size)) != rx_head) {
-		desc = &adapter->rx_ring[next];
+	bool done = true;
+	unsigned int i;
 
-		if (!(desc->status & FRANK_E1000E_RX_STAT_DD)) {
-			break;
-		}
+	for (i = 0; i < adapter->num_tx_queues; i++)
+		done &= frank_e1000e_clear_tx_ring(adapter, &adapter->tx_ring[i], budget);
 
-		skb = adapter->rx_skb[next];
+	return done;
+}
 
-		new_skb = netdev_alloc_skb(adapter->netdev, 2048 + NET_IP_ALIGN);
+/*
+ * Copy a small frame out of its receive buffer into a fresh napi skb. The
+ * buffer itself stays mapped and is handed back to the hardware as is.
+ */
+static struct sk_buff *frank_e1000e_rx_copybreak(struct frank_e1000e_adapter *adapter,
+		struct sk_buff *skb, dma_addr_t dma_addr, unsigned int length)
+{
+	struct device *dev = &adapter->pci->dev;
+	struct sk_buff *new_skb;
+
+	new_skb = napi_alloc_skb(&adapter->rx_napi, length);
+	if (!new_skb)
+		return NULL;
+
+	dma_sync_single_for_cpu(dev, dma_addr, length, DMA_FROM_DEVICE);
+	skb_copy_to_linear_data(new_skb, skb->data, length);
+	dma_sync_single_for_device(dev, dma_addr, length, DMA_FROM_DEVICE);
+
+	skb_put(new_skb, length);
+
+	return new_skb;
+}
+
+/*
+ * The descriptor layout is fixed per part, so ext is always a constant
+ * here and the clean loop below is built once per layout.
+ */
+static __always_inline u32 frank_e1000e_rx_staterr(union frank_e1000e_rx_desc *desc,
+		unsigned int *length, const bool ext)
+{
+	if (ext) {
+		*length = le16_to_cpu(desc->wb.length);
+		return le32_to_cpu(desc->wb.status_error);
+	}
+
+	*length = le16_to_cpu(desc->legacy.length);
+	return desc->legacy.status | ((u32)desc->legacy.errors << 24);
+}
+
+/* Hand the RSS hash to the stack so GRO and RPS do not recompute it */
+static __always_inline void frank_e1000e_rx_hash(struct frank_e1000e_adapter *adapter,
+		union frank_e1000e_rx_desc *desc, struct sk_buff *skb, const bool ext)
+{
+	u32 type;
+
+	if (!ext || !(adapter->netdev->features & NETIF_F_RXHASH))
+		return;
+
+	type = le32_to_cpu(desc->wb.mrq) & FRANK_E1000E_RX_MRQ_RSSTYPE;
+	if (!type)
+		return;
+
+	skb_set_hash(skb, le32_to_cpu(desc->wb.rss),
+			(type == FRANK_E1000E_RSSTYPE_TCP_IPV4 ||
+			 type == FRANK_E1000E_RSSTYPE_TCP_IPV6) ?
+			PKT_HASH_TYPE_L4 : PKT_HASH_TYPE_L3);
+}
+
+/* Returns false when the hardware saw a bad checksum */
+static bool frank_e1000e_rx_checksum(struct frank_e1000e_adapter *adapter,
+		u32 staterr, struct sk_buff *skb)
+{
+	skb_checksum_none_assert(skb);
+
+	if (!(adapter->netdev->features & NETIF_F_RXCSUM) ||
+		(staterr & FRANK_E1000E_RX_STAT_IXSM))
+		return true;
+
+	if (staterr & (FRANK_E1000E_RX_ERR_TCPE | FRANK_E1000E_RX_ERR_IPE))
+		return false;
+
+	if (staterr & (FRANK_E1000E_RX_STAT_TCPCS | FRANK_E1000E_RX_STAT_UDPCS))
+		skb->ip_summed = CHECKSUM_UNNECESSARY;
+
+	return true;
+}
+
+static __always_inline int frank_e1000e_clear_rx_ring(struct frank_e1000e_adapter *adapter,
+		int budget, const bool ext)
+{
+	union frank_e1000e_rx_desc *desc;
+	struct frank_e1000e_rx_buffer *buffer_info;
+	struct net_device *netdev = adapter->netdev;
+	struct pci_dev *pdev = adapter->pci;
+	unsigned int next = adapter->rx_ring.next_to_clean;
+	unsigned int unposted;
+	struct sk_buff *skb, *new_skb;
+	int completed = 0, cnt = 0, alloc_fail = 0, csum_bad = 0;
+	unsigned int size = 0;
+	unsigned int length;
+	dma_addr_t dma_addr;
+	u32 staterr;
+	
+	/* DD alone says how far the NIC got, RDH is never read back */
+	while (cnt < budget) {
+		desc = &adapter->rx_ring.desc[next];
+
+		staterr = frank_e1000e_rx_staterr(desc, &length, ext);
+		if (!(staterr & FRANK_E1000E_RX_STAT_DD)) {
+			break;
+		}
+
+		/* Nothing else in the descriptor is valid before DD */
+		dma_rmb();
+		staterr = frank_e1000e_rx_staterr(desc, &length, ext);
+
+		buffer_info = &adapter->rx_ring.buffer_info[next];
+		skb = buffer_info->skb;
+
+		if (length < READ_ONCE(adapter->rx_ring.copybreak)) {
+			skb = frank_e1000e_rx_copybreak(adapter, skb,
+					buffer_info->dma, length);
+			if (!skb) {
+				alloc_fail++;
+				goto do_next;
+			}
+
+			goto deliver;
+		}
+
+		new_skb = netdev_alloc_skb(adapter->netdev, 2048 + NET_IP_ALIGN);
 		if (!new_skb) {
 			pci_warn(pdev, "Failed to alloc new sk buffer\n");
-			netdev->stats.rx_dropped ++;
+			alloc_fail++;
 			goto do_next;			
 		}
 
@@ -318,108 +1101,265 @@ static void frank_e1000e_clear_rx_ring(struct frank_e1000e_adapter *adapter)
 		dma_addr = dma_map_single(&pdev->dev, new_skb->data, 2048, DMA_FROM_DEVICE);
 		if (dma_mapping_error(&pdev->dev, dma_addr)) {
 			dev_kfree_skb(new_skb);
-			netdev->stats.rx_dropped++;
+			alloc_fail++;
 			pci_warn(pdev, "Failed to mapping new sk buffer\n");
 			goto do_next;
 		}
 			
-		dma_unmap_single(&pdev->dev, le64_to_cpu(desc->buffer_addr),
+		dma_unmap_single(&pdev->dev, buffer_info->dma,
 				2048, DMA_FROM_DEVICE);
 
 		/* Set packet length from descriptor */
-		skb_put(skb, le16_to_cpu(desc->length));
-		
+		skb_put(skb, length);
+
+		buffer_info->dma = dma_addr;
+		buffer_info->skb = new_skb; /* Update to new SKB */
+deliver:
+		frank_e1000e_rx_hash(adapter, desc, skb, ext);
+		if (!frank_e1000e_rx_checksum(adapter, staterr, skb))
+			csum_bad++;
+
 		/* Set protocol type for network stack */
 		skb->protocol = eth_type_trans(skb, netdev);
-		
+
 		size += skb->len;
-		netif_rx(skb);
-		
-		desc->buffer_addr = cpu_to_le64(dma_addr);
-		adapter->rx_skb[next] = new_skb; /* Update to new SKB */
+		napi_gro_receive(&adapter->rx_napi, skb);
 		completed ++; 
 do_next:
-		desc->status = 0; /* Clear descriptor status */
+		/* Write-back clobbered the address, hand the slot back whole */
+		desc->read.buffer_addr = cpu_to_le64(buffer_info->dma);
+		desc->read.reserved = 0;
+		next = (next + 1) % adapter->rx_ring.count;
 		cnt ++;
 	}
 
 	if (cnt) {
-		adapter->rx_tail = (adapter->rx_tail + cnt) % adapter->rx_ring_size;
-		frank_e1000e_writel(adapter->hw, FRANK_E1000E_RDT0_REG,adapter->rx_tail);
+		adapter->rx_ring.next_to_clean = next;
+
+		/*
+		 * The slot before next_to_clean is the newest refilled one.
+		 * Move the tail in batches to keep MMIO writes off most polls.
+		 */
+		unposted = (next + 2 * adapter->rx_ring.count - 1 - adapter->rx_ring.tail) %
+				adapter->rx_ring.count;
+		if (unposted >= FRANK_E1000E_RX_BUFFER_WRITE) {
+			adapter->rx_ring.tail = (next + adapter->rx_ring.count - 1) %
+					adapter->rx_ring.count;
+			frank_e1000e_writel(adapter->hw, FRANK_E1000E_RDT0_REG,
+					adapter->rx_ring.tail);
+		}
 
-		netdev->stats.rx_packets += completed;
-		netdev->stats.rx_bytes += size;
+		u64_stats_update_begin(&adapter->rx_ring.stats.syncp);
+		u64_stats_add(&adapter->rx_ring.stats.packets, completed);
+		u64_stats_add(&adapter->rx_ring.stats.bytes, size);
+		u64_stats_add(&adapter->rx_ring.stats.alloc_fail, alloc_fail);
+		u64_stats_add(&adapter->rx_ring.stats.csum_bad, csum_bad);
+		u64_stats_update_end(&adapter->rx_ring.stats.syncp);
 	}
+
+	return cnt;
 }
 
+/* Only the 82574 has MSI-X, and it always runs extended descriptors */
+static int frank_e1000e_rx_poll(struct napi_struct *napi, int budget)
+{
+	struct frank_e1000e_adapter *adapter = container_of(napi,
+					struct frank_e1000e_adapter, rx_napi);
+	u64 *prev = frank_e1000e_mmio_reads_begin(&adapter->rx_ring.mmio_reads);
+	int work_done;
+
+	work_done = frank_e1000e_clear_rx_ring(adapter, budget, true);
+
+	/* Once down has masked the device a late poll must not unmask it */
+	if (work_done < budget && napi_complete_done(napi, work_done) &&
+		adapter->rx_ims && !test_bit(__FRANK_E1000E_DOWN, &adapter->state))
+		frank_e1000e_writel(adapter->hw, FRANK_E1000E_IMS_REG, adapter->rx_ims);
+
+	frank_e1000e_mmio_reads_end(prev);
+
+	return work_done;
+}
+
+/*
+ * The queue vectors touch no registers at all. EIAC already cleared the
+ * cause and EIAM masked it when the message was sent, the poll re-arms it.
+ */
 static irqreturn_t frank_e1000e_msix_rx_handler(int irq, void *data)
 {
 	struct frank_e1000e_adapter *adapter = data;
+	u64 *prev = frank_e1000e_mmio_reads_begin(&adapter->rx_ring.mmio_reads);
+
+	adapter->rx_ring.irqs++;
+	napi_schedule(&adapter->rx_napi);
 
-	frank_e1000e_clear_rx_ring(adapter);
+	frank_e1000e_mmio_reads_end(prev);
 
-	frank_e1000e_writel(adapter->hw, FRANK_E1000E_IMS_REG, FRANK_E1000E_INT_RXQ0);
 	return IRQ_HANDLED;
 }
 
+static int frank_e1000e_tx_poll(struct napi_struct *napi, int budget)
+{
+	struct frank_e1000e_adapter *adapter = container_of(napi,
+					struct frank_e1000e_adapter, tx_napi);
+	u64 *prev = frank_e1000e_mmio_reads_begin(&adapter->tx_ring[0].mmio_reads);
+	int work_done = budget;
+
+	/* A zero budget comes from netpoll, which must not complete NAPI */
+	if (frank_e1000e_clear_tx_rings(adapter, budget) && budget) {
+		work_done = 0;
+		if (napi_complete_done(napi, 0) && adapter->tx_ims &&
+			!test_bit(__FRANK_E1000E_DOWN, &adapter->state))
+			frank_e1000e_writel(adapter->hw, FRANK_E1000E_IMS_REG,
+					adapter->tx_ims);
+	}
+
+	frank_e1000e_mmio_reads_end(prev);
+
+	return work_done;
+}
+
 static irqreturn_t frank_e1000e_msix_tx_handler(int irq, void *data)
 {
 	struct frank_e1000e_adapter *adapter = data;
+	u64 *prev = frank_e1000e_mmio_reads_begin(&adapter->tx_ring[0].mmio_reads);
+
+	adapter->tx_ring[0].irqs++;
+	napi_schedule(&adapter->tx_napi);
 
-	frank_e1000e_clear_tx_ring(adapter);
+	frank_e1000e_mmio_reads_end(prev);
 
-	frank_e1000e_writel(adapter->hw, FRANK_E1000E_IMS_REG, FRANK_E1000E_INT_TXQ0);
 	return IRQ_HANDLED;
 }
 
+static void frank_e1000e_link_task(struct work_struct *work)
+{
+	struct frank_e1000e_adapter *adapter = container_of(work,
+					struct frank_e1000e_adapter, link_task);
+	u32 status;
+
+	status = frank_e1000e_readl(adapter->hw, FRANK_E1000E_STATUS_REG);
+	pci_info(adapter->pci, "Link %s\n", (status & FRANK_E1000E_STATUS_LU) ?
+			"Up" : "Down");
+
+	/* rtnl is out, down() cancels this work with it held */
+	if (status & FRANK_E1000E_STATUS_LU) {
+		mutex_lock(&adapter->fc_lock);
+		frank_e1000e_fc_resolve(adapter, status);
+		mutex_unlock(&adapter->fc_lock);
+	}
+}
+
 static irqreturn_t frank_e1000e_msix_other_handler(int irq, void *data)
 {
 	struct frank_e1000e_adapter *adapter = data;
-	struct pci_dev *pdev = adapter->pci;
-	u32 val, status;
-	
+	u32 val;
+
+	adapter->other_irqs++;
+
+	/* Cold path, the only vector that still has to look at ICR */
 	val = frank_e1000e_readl(adapter->hw, FRANK_E1000E_ICR_REG);
 
-	if (val & FRANK_E1000E_INT_LSC) {
-		status = frank_e1000e_readl(adapter->hw, FRANK_E1000E_STATUS_REG);
-		pci_info(pdev, "Link %s\n", (status & FRANK_E1000E_STATUS_LU) ? 
-				"Up" : "Down");
-	}
+	if (val & FRANK_E1000E_INT_LSC)
+		schedule_work(&adapter->link_task);
 
+	/* OTHER is left out of IAM, so acking the causes is all it takes */
 	frank_e1000e_writel(adapter->hw, FRANK_E1000E_ICR_REG, val);
 
-	frank_e1000e_writel(adapter->hw, FRANK_E1000E_IMS_REG, FRANK_E1000E_INT_OTHER);
 	return IRQ_HANDLED;
 }
 
 
+/*
+ * Single vector top half. Reading ICR already acknowledges every cause, so
+ * all that is left to do here is claim the interrupt, mask the device and
+ * hand the rings over to NAPI.
+ */
 static irqreturn_t frank_e1000e_irq_handler(int irq, void *data)
 {
 	struct frank_e1000e_adapter *adapter = data;
-	struct pci_dev *pdev = adapter->pci;
-	u32 val, status;
+	u32 val;
 
+	/* In D3hot the registers can't be read and the device can't assert */
+	if (pm_runtime_suspended(&adapter->pci->dev))
+		return IRQ_NONE;
+
+	/* Reading ICR acks the cause, a level triggered line drops with it */
 	val = frank_e1000e_readl(adapter->hw, FRANK_E1000E_ICR_REG);
-	
-	if (val & FRANK_E1000E_INT_LSC) {
-		status = frank_e1000e_readl(adapter->hw, FRANK_E1000E_STATUS_REG);
-		pci_info(pdev, "Link %s\n", (status & FRANK_E1000E_STATUS_LU) ? 
-				"Up" : "Down");
-	}
 
-	if (val & (FRANK_E1000E_INT_TXDW | FRANK_E1000E_INT_TXQE) ) {
-		frank_e1000e_clear_tx_ring(adapter);
-	}
+	/* Not ours, someone else on the shared line asserted it */
+	if (!(val & adapter->icr_asserted))
+		return IRQ_NONE;
+
+	/* Raced with down, which has already masked everything again */
+	if (test_bit(__FRANK_E1000E_DOWN, &adapter->state))
+		return IRQ_HANDLED;
+
+	/* Link and other causes land here too, rx_irqs stays MSI-X only */
+	adapter->legacy_irqs++;
+
+	if (!adapter->icr_auto_mask)
+		frank_e1000e_writel(adapter->hw, FRANK_E1000E_IMC_REG,
+				FRANK_E1000E_INT_ALL);
+
+	if (val & FRANK_E1000E_INT_LSC)
+		schedule_work(&adapter->link_task);
+
+	napi_schedule(&adapter->rx_napi);
 
-	if (val & (FRANK_E1000E_INT_RXT0 | FRANK_E1000E_INT_RXDMT0)) {
-		frank_e1000e_clear_rx_ring(adapter);
-	}
-	
-	
-	frank_e1000e_writel(adapter->hw, FRANK_E1000E_ICR_REG, val);
 	return IRQ_HANDLED;
 }
 
+static __always_inline int frank_e1000e_poll(struct napi_struct *napi,
+		int budget, const bool ext)
+{
+	struct frank_e1000e_adapter *adapter = container_of(napi,
+					struct frank_e1000e_adapter, rx_napi);
+	bool tx_done;
+	int work_done;
+
+	tx_done = frank_e1000e_clear_tx_rings(adapter, budget);
+
+	work_done = frank_e1000e_clear_rx_ring(adapter, budget, ext);
+	if (!tx_done)
+		work_done = budget;
+
+	if (work_done < budget && napi_complete_done(napi, work_done) &&
+		!test_bit(__FRANK_E1000E_DOWN, &adapter->state))
+		frank_e1000e_enable_intr(adapter);
+
+	return work_done;
+}
+
+/* Single vector polls, init_irq picks the one matching the RX descriptors */
+static int frank_e1000e_poll_ext(struct napi_struct *napi, int budget)
+{
+	return frank_e1000e_poll(napi, budget, true);
+}
+
+static int frank_e1000e_poll_legacy(struct napi_struct *napi, int budget)
+{
+	return frank_e1000e_poll(napi, budget, false);
+}
+
+/*
+ * Poll mode tick, stands in for the queue interrupts. The NAPI polls see
+ * an empty ring through the DD bits alone, so with MSI-X an idle tick
+ * costs no MMIO at all.
+ */
+static enum hrtimer_restart frank_e1000e_poll_timer(struct hrtimer *timer)
+{
+	struct frank_e1000e_adapter *adapter = container_of(timer,
+					struct frank_e1000e_adapter, poll_timer);
+
+	napi_schedule(&adapter->rx_napi);
+	if (adapter->msix_enabled)
+		napi_schedule(&adapter->tx_napi);
+
+	hrtimer_forward_now(timer, adapter->poll_interval);
+
+	return HRTIMER_RESTART;
+}
+
 struct frank_e1000e_msix frank_e1000e_msix_vectors[FRANK_E1000E_MSIX_VECTORS]= {
 	{.name = FRANK_E1000E_MSIX_RX_NAME, .handler = frank_e1000e_msix_rx_handler},
 	{.name = FRANK_E1000E_MSIX_TX_NAME, .handler = frank_e1000e_msix_tx_handler},
@@ -432,27 +1372,34 @@ static void frank_e1000e_config_msix(struct frank_e1000e_adapter *adapter)
 
 	val = frank_e1000e_readl(adapter->hw, FRANK_E1000E_IVAR);
 
-	//Disable RXQ1 and TXQ1
+	//Disable RXQ1
 	val &= ~FRANK_E1000E_IVAR_INT_ALLOC_EN(FRANK_E1000E_IVAR_RXQ1);
-	val &= ~FRANK_E1000E_IVAR_INT_ALLOC_EN(FRANK_E1000E_IVAR_TXQ1);
 	
 	//RXQ0
 	val |= FRANK_E1000E_IVAR_INT_ALLOC(FRANK_E1000E_IVAR_RXQ0, FRANK_E1000E_MSIX_RX);
 	val |= FRANK_E1000E_IVAR_INT_ALLOC_EN(FRANK_E1000E_IVAR_RXQ0);
 	frank_e1000e_writel(adapter->hw, FRANK_E1000E_EITER(FRANK_E1000E_MSIX_RX),
-		1);
+		FRANK_E1000E_ITR_20K);
 
 	//TXQ0
 	val |= FRANK_E1000E_IVAR_INT_ALLOC(FRANK_E1000E_IVAR_TXQ0, FRANK_E1000E_MSIX_TX);
 	val |= FRANK_E1000E_IVAR_INT_ALLOC_EN(FRANK_E1000E_IVAR_TXQ0);
 	frank_e1000e_writel(adapter->hw, FRANK_E1000E_EITER(FRANK_E1000E_MSIX_TX),
-		1);
+		FRANK_E1000E_ITR_20K);
 
-	//OTHER
+	//TXQ1 shares the TX vector, one NAPI context cleans both rings
+	if (adapter->num_tx_queues > 1) {
+		val |= FRANK_E1000E_IVAR_INT_ALLOC(FRANK_E1000E_IVAR_TXQ1, FRANK_E1000E_MSIX_TX);
+		val |= FRANK_E1000E_IVAR_INT_ALLOC_EN(FRANK_E1000E_IVAR_TXQ1);
+	} else {
+		val &= ~FRANK_E1000E_IVAR_INT_ALLOC_EN(FRANK_E1000E_IVAR_TXQ1);
+	}
+
+	//OTHER is rare and carries link changes, leave it unthrottled
 	val |= FRANK_E1000E_IVAR_INT_ALLOC(FRANK_E1000E_IVAR_OTHER, FRANK_E1000E_MSIX_OTHER);
 	val |= FRANK_E1000E_IVAR_INT_ALLOC_EN(FRANK_E1000E_IVAR_OTHER);
 	frank_e1000e_writel(adapter->hw, FRANK_E1000E_EITER(FRANK_E1000E_MSIX_OTHER),
-		1);
+		0);
 
 	val |= FRANK_E1000E_IVAR_ITR_WB;
 	frank_e1000e_writel(adapter->hw, FRANK_E1000E_IVAR, val);
@@ -462,8 +1409,74 @@ static void frank_e1000e_config_msix(struct frank_e1000e_adapter *adapter)
 	val |= FRANK_E1000E_CTRL_EXT_EIAME | FRANK_E1000E_CTRL_EXT_PBA_CLR;
 	frank_e1000e_writel(adapter->hw,FRANK_E1000E_CTRL_EXT, val);
 
-	val = FRANK_E1000E_INT_RXQ0 | FRANK_E1000E_INT_TXQ0 | FRANK_E1000E_INT_OTHER;
+	val = adapter->rx_ims | adapter->tx_ims | FRANK_E1000E_INT_OTHER;
 	frank_e1000e_writel(adapter->hw,FRANK_E1000E_EIAC, val);
+
+	/* The queue vectors mask themselves, their handlers skip IMC */
+	val = adapter->rx_ims | adapter->tx_ims;
+	frank_e1000e_writel(adapter->hw, FRANK_E1000E_IAM, val);
+}
+
+/* Let the ICR read in the single vector handler mask the device as well */
+static void frank_e1000e_config_icr_auto_mask(struct frank_e1000e_adapter *adapter)
+{
+	u32 val;
+
+	if (!adapter->icr_auto_mask)
+		return;
+
+	val = frank_e1000e_readl(adapter->hw, FRANK_E1000E_CTRL_EXT);
+	val |= FRANK_E1000E_CTRL_EXT_IAME;
+	frank_e1000e_writel(adapter->hw, FRANK_E1000E_CTRL_EXT, val);
+
+	frank_e1000e_writel(adapter->hw, FRANK_E1000E_IAM, FRANK_E1000E_INT_ALL);
+}
+
+/* A single vector carries every cause, cap it like the MSI-X queue vectors */
+static void frank_e1000e_config_itr(struct frank_e1000e_adapter *adapter)
+{
+	frank_e1000e_writel(adapter->hw, FRANK_E1000E_ITR_REG, FRANK_E1000E_ITR_20K);
+}
+
+/*
+ * Pin each queue vector's NAPI context and XPS map to the CPUs the managed
+ * affinity spread assigned to it, so ring servicing stays on one core.
+ */
+static void frank_e1000e_set_irq_affinity(struct frank_e1000e_adapter *adapter)
+{
+	struct pci_dev *pdev = adapter->pci;
+	const struct cpumask *mask;
+	int i;
+
+	for (i = 0; i < FRANK_E1000E_MSIX_OTHER; i++) {
+		mask = pci_irq_get_affinity(pdev, i);
+		if (!mask)
+			continue;
+
+		irq_update_affinity_hint(pci_irq_vector(pdev, i), mask);
+
+		if (i == FRANK_E1000E_MSIX_RX && !cpumask_empty(mask))
+			adapter->rx_ring.numa_node = cpu_to_node(cpumask_first(mask));
+	}
+
+	frank_e1000e_set_xps(adapter);
+
+	netif_napi_set_irq(&adapter->rx_napi,
+			pci_irq_vector(pdev, FRANK_E1000E_MSIX_RX));
+	netif_napi_set_irq(&adapter->tx_napi,
+			pci_irq_vector(pdev, FRANK_E1000E_MSIX_TX));
+}
+
+static void frank_e1000e_clear_irq_affinity(struct frank_e1000e_adapter *adapter)
+{
+	struct pci_dev *pdev = adapter->pci;
+	int i;
+
+	if (!adapter->msix_enabled)
+		return;
+
+	for (i = 0; i < FRANK_E1000E_MSIX_OTHER; i++)
+		irq_update_affinity_hint(pci_irq_vector(pdev, i), NULL);
 }
 
 static int frank_e1000e_init_irq(struct frank_e1000e_adapter *adapter)
@@ -471,12 +1484,23 @@ static int frank_e1000e_init_irq(struct frank_e1000e_adapter *adapter)
 	int ret = 0;
 	struct pci_dev *pdev = adapter->pci;
 	int i;
+	/* Only the RX/TX queue vectors are spread, "Other" is left unmanaged */
+	struct irq_affinity affd = {
+		.post_vectors = 1,
+	};
+
+	/* Only the 82574 has MSI-X, don't bother asking on the others */
+	ret = -ENODEV;
+	if (adapter->hw->info->flags & FRANK_E1000E_FLAG_MSIX) {
+		ret = pci_alloc_irq_vectors_affinity(pdev, FRANK_E1000E_MSIX_VECTORS,
+					FRANK_E1000E_MSIX_VECTORS,
+					PCI_IRQ_MSIX | PCI_IRQ_AFFINITY, &affd);
+		if (ret < 0)
+			pci_info(pdev, "MSI-X unavailable, falling back to a single vector\n");
+	}
 
-	ret = pci_alloc_irq_vectors(pdev, 1, FRANK_E1000E_MSIX_VECTORS,
-				PCI_IRQ_ALL_TYPES);
-	//ret = pci_alloc_irq_vectors(pdev, 1, 1,
-	//			PCI_IRQ_INTX);
-
+	if (ret < 0)
+		ret = pci_alloc_irq_vectors(pdev, 1, 1, PCI_IRQ_MSI | PCI_IRQ_INTX);
 
 	if (ret < 0){
 		pci_err(pdev, "Failed to alloc irq vectors\n");
@@ -486,13 +1510,42 @@ static int frank_e1000e_init_irq(struct frank_e1000e_adapter *adapter)
 	pci_info(pdev, "Allocated %d IRQ vectors\n", ret);
 
 	if (ret == 1) {
+		adapter->msi_enabled = pdev->msi_enabled;
+		/*
+		 * PCIe parts flag their own assertions in ICR, the older PCI
+		 * parts only report a zero ICR when the interrupt is not theirs.
+		 */
+		adapter->icr_asserted =
+				(adapter->hw->info->flags & FRANK_E1000E_FLAG_PCIE) ?
+				FRANK_E1000E_ICR_INT_ASSERTED : FRANK_E1000E_INT_ALL;
+		/* IAM only exists on the PCIe parts */
+		adapter->icr_auto_mask =
+				!!(adapter->hw->info->flags & FRANK_E1000E_FLAG_PCIE);
+		frank_e1000e_config_icr_auto_mask(adapter);
+		frank_e1000e_config_itr(adapter);
+		netif_napi_add(adapter->netdev, &adapter->rx_napi,
+				adapter->rx_ring.ext ? frank_e1000e_poll_ext :
+				frank_e1000e_poll_legacy);
+
 		ret = devm_request_irq(&pdev->dev,  pci_irq_vector(pdev, 0), frank_e1000e_irq_handler,
-					IRQF_SHARED, DRIVER_NAME, adapter);
+					adapter->msi_enabled ? 0 : IRQF_SHARED,
+					DRIVER_NAME, adapter);
 		if (ret) {
 			pci_err(pdev, "Failed to request irq\n");
 			goto error;
 		}		
 	} else {
+		adapter->msix_enabled = true;
+		/* In poll mode the queue causes stay masked for good */
+		if (!adapter->poll_interval) {
+			adapter->rx_ims = FRANK_E1000E_INT_RXQ0;
+			adapter->tx_ims = FRANK_E1000E_INT_TXQ0;
+			if (adapter->num_tx_queues > 1)
+				adapter->tx_ims |= FRANK_E1000E_INT_TXQ1;
+		}
+		netif_napi_add(adapter->netdev, &adapter->rx_napi, frank_e1000e_rx_poll);
+		netif_napi_add(adapter->netdev, &adapter->tx_napi, frank_e1000e_tx_poll);
+
 		for (i = 0; i < FRANK_E1000E_MSIX_VECTORS; i++) {
 			ret = devm_request_irq(&pdev->dev,  pci_irq_vector(pdev, i), 
 						frank_e1000e_msix_vectors[i].handler,
@@ -503,6 +1556,7 @@ static int frank_e1000e_init_irq(struct frank_e1000e_adapter *adapter)
 			}			
 		}
 		frank_e1000e_config_msix(adapter);
+		frank_e1000e_set_irq_affinity(adapter);
 	}
 
 	return 0;
@@ -511,44 +1565,148 @@ error:
 	return ret;
 }
 
-static int frank_e1000e_setup_tx_ring(struct frank_e1000e_adapter *adapter)
+void frank_e1000e_config_tx_thresholds(struct frank_e1000e_adapter *adapter)
+{
+	u32 reg, val;
+	unsigned int i;
+
+	for (i = 0; i < adapter->num_tx_queues; i++) {
+		reg = FRANK_E1000E_TXQ_REG(FRANK_E1000E_TXDCTL0_REG, i);
+		val = frank_e1000e_readl(adapter->hw, reg);
+		val &= ~(FRANK_E1000E_DCTL_PTHRESH_MASK | FRANK_E1000E_DCTL_HTHRESH_MASK |
+				FRANK_E1000E_DCTL_WTHRESH_MASK);
+		val |= FRANK_E1000E_DCTL_PTHRESH(adapter->tx_pthresh);
+		val |= FRANK_E1000E_DCTL_HTHRESH(adapter->tx_hthresh);
+		val |= FRANK_E1000E_DCTL_WTHRESH(adapter->tx_wthresh);
+		val |= FRANK_E1000E_DCTL_GRAN;
+		frank_e1000e_writel(adapter->hw, reg, val);
+	}
+}
+
+/*
+ * The write-back threshold only takes effect while the packet delay timer
+ * runs, without RDTR every completed descriptor is written back at once.
+ */
+void frank_e1000e_config_rx_thresholds(struct frank_e1000e_adapter *adapter)
 {
-	size_t size;
-	u64 tdba;
 	u32 val;
+
+	frank_e1000e_writel(adapter->hw, FRANK_E1000E_RDTR_REG,
+			FRANK_E1000E_USECS_TO_DELAY(adapter->rx_delay_us));
+	frank_e1000e_writel(adapter->hw, FRANK_E1000E_RADV_REG,
+			FRANK_E1000E_USECS_TO_DELAY(adapter->rx_abs_delay_us));
+
+	val = frank_e1000e_readl(adapter->hw, FRANK_E1000E_RXDCTL0_REG);
+	val &= ~(FRANK_E1000E_DCTL_PTHRESH_MASK | FRANK_E1000E_DCTL_HTHRESH_MASK |
+			FRANK_E1000E_DCTL_WTHRESH_MASK);
+	val |= FRANK_E1000E_DCTL_PTHRESH(adapter->rx_pthresh);
+	val |= FRANK_E1000E_DCTL_HTHRESH(adapter->rx_hthresh);
+	val |= FRANK_E1000E_DCTL_WTHRESH(adapter->rx_wthresh);
+	val |= FRANK_E1000E_DCTL_GRAN;
+	frank_e1000e_writel(adapter->hw, FRANK_E1000E_RXDCTL0_REG, val);
+}
+
+static int frank_e1000e_setup_tx_ring(struct frank_e1000e_adapter *adapter,
+		struct frank_e1000e_tx_ring *tx_ring)
+{
+	size_t size;
 	struct pci_dev *pdev = adapter->pci;
 	
-	adapter->tx_ring_size = FRANK_E1000E_TX_RING_SIZE;
+	tx_ring->count = FRANK_E1000E_TX_RING_SIZE;
+	tx_ring->tdt_reg = FRANK_E1000E_TXQ_REG(FRANK_E1000E_TDT_REG, tx_ring->index);
 	
-	adapter->tx_head = 0;
-	adapter->tx_tail = 0;
+	tx_ring->head = 0;
+	tx_ring->tail = 0;
 
-	size = adapter->tx_ring_size * sizeof(struct frank_e1000e_tx_desc);
+	size = tx_ring->count * sizeof(struct frank_e1000e_tx_desc);
 	size = ALIGN(size, 4096);
 
-	adapter->tx_ring = dmam_alloc_coherent(&pdev->dev, size, 
-						&adapter->tx_ring_dma, GFP_KERNEL);
-	if (!adapter->tx_ring) {
+	/*
+	 * Coherent memory and devm allocations both land on dev_to_node(),
+	 * which keeps the descriptor rings next to the device's root port.
+	 */
+	tx_ring->desc = dmam_alloc_coherent(&pdev->dev, size, 
+						&tx_ring->dma, GFP_KERNEL);
+	if (!tx_ring->desc) {
 		pci_err(pdev, "Failed to alloc tx ring\n");
 		return -ENOMEM;
 	}
 
-	adapter->tx_skb = devm_kzalloc(&pdev->dev, 
-						adapter->tx_ring_size * sizeof(struct sk_buff *), GFP_KERNEL);
+	tx_ring->buffer_info = devm_kcalloc(&pdev->dev, tx_ring->count,
+						sizeof(struct frank_e1000e_tx_buffer), GFP_KERNEL);
+	if (!tx_ring->buffer_info) {
+		pci_err(pdev, "Failed to alloc tx_buffer_info\n");
+		return -ENOMEM;
+	}
 
-	if (!adapter->tx_skb) {
-		pci_err(pdev, "Failed to alloc tx_skb\n");
+	/* Mapped once for the lifetime of the device, see tx_copybreak */
+	tx_ring->bounce = dmam_alloc_coherent(&pdev->dev,
+						tx_ring->count * FRANK_E1000E_TX_BOUNCE_SIZE,
+						&tx_ring->bounce_dma, GFP_KERNEL);
+	if (!tx_ring->bounce) {
+		pci_err(pdev, "Failed to alloc tx bounce buffers\n");
 		return -ENOMEM;
 	}
 
-	tdba = adapter->tx_ring_dma; 
-	size = adapter->tx_ring_size * sizeof(struct frank_e1000e_tx_desc);
+	pci_info(pdev, "TX ring %u initialize with %u descriptors\n",
+			tx_ring->index, tx_ring->count);
+
+	return 0; 
+}
+
+/*
+ * The 82574 has no strict priority between its TX queues, it round robins
+ * over them and fetches up to TARC.COUNT descriptors from a queue per turn.
+ * Equal counts share the wire fairly, a lopsided pair (see tx_weight0/1)
+ * lets the control class on queue 1 overtake bulk traffic on queue 0.
+ */
+void frank_e1000e_config_tx_arb(struct frank_e1000e_adapter *adapter)
+{
+	u32 reg, val, count;
+	unsigned int i;
+
+	if (adapter->num_tx_queues < 2)
+		return;
+
+	for (i = 0; i < adapter->num_tx_queues; i++) {
+		count = adapter->tx_prio ? adapter->tx_weight[i] :
+				FRANK_E1000E_TX_WEIGHT_EQUAL;
+
+		/* The other TARC bits carry errata settings, leave them alone */
+		reg = FRANK_E1000E_TXQ_REG(FRANK_E1000E_TARC0_REG, i);
+		val = frank_e1000e_readl(adapter->hw, reg);
+		val &= ~FRANK_E1000E_TARC_COUNT_MASK;
+		val |= FRANK_E1000E_TARC_COUNT(count) | FRANK_E1000E_TARC_ENABLE;
+		frank_e1000e_writel(adapter->hw, reg, val);
+	}
+}
+
+static void frank_e1000e_configure_tx(struct frank_e1000e_adapter *adapter)
+{
+	struct frank_e1000e_tx_ring *tx_ring;
+	size_t size;
+	u64 tdba;
+	u32 val;
+	unsigned int i;
+
+	for (i = 0; i < adapter->num_tx_queues; i++) {
+		tx_ring = &adapter->tx_ring[i];
+		tdba = tx_ring->dma; 
+		size = tx_ring->count * sizeof(struct frank_e1000e_tx_desc);
+
+		frank_e1000e_writel(adapter->hw, FRANK_E1000E_TXQ_REG(FRANK_E1000E_TDBAL_REG, i),
+				tdba & DMA_BIT_MASK(32));
+		frank_e1000e_writel(adapter->hw, FRANK_E1000E_TXQ_REG(FRANK_E1000E_TDBAH_REG, i),
+				(tdba >> 32) & 0xFFFFFFFF);
+		frank_e1000e_writel(adapter->hw, FRANK_E1000E_TXQ_REG(FRANK_E1000E_TDLEN_REG, i),
+				size);
+		frank_e1000e_writel(adapter->hw, FRANK_E1000E_TXQ_REG(FRANK_E1000E_TDH_REG, i),
+				tx_ring->head);
+		frank_e1000e_writel(adapter->hw, tx_ring->tdt_reg, tx_ring->tail);
+	}
 
-	frank_e1000e_writel(adapter->hw, FRANK_E1000E_TDBAL_REG, tdba & DMA_BIT_MASK(32));
-	frank_e1000e_writel(adapter->hw, FRANK_E1000E_TDBAH_REG, (tdba >> 32) & 0xFFFFFFFF);
-	frank_e1000e_writel(adapter->hw, FRANK_E1000E_TDLEN_REG, size);
-	frank_e1000e_writel(adapter->hw, FRANK_E1000E_TDH_REG, adapter->tx_head);
-	frank_e1000e_writel(adapter->hw, FRANK_E1000E_TDT_REG, adapter->tx_tail);
+	frank_e1000e_config_tx_thresholds(adapter);
+	frank_e1000e_config_tx_arb(adapter);
 
 	val = frank_e1000e_readl(adapter->hw, FRANK_E1000E_TCTL_REG);
 	val &= ~FRANK_E1000E_TCTL_CT_MASK;
@@ -556,94 +1714,182 @@ static int frank_e1000e_setup_tx_ring(struct frank_e1000e_adapter *adapter)
 	val |= FRANK_E1000E_TCTL_EN;
 	val |= FRANK_E1000E_TCTL_PSP | FRANK_E1000E_TCTL_RTLC;
 	val |= FRANK_E1000E_TCTL_CT_SET(FRANK_E1000E_COLLISION_THRESHOLD);
+	/* Let the DMA engine keep a read request open per queue */
+	if (adapter->num_tx_queues > 1)
+		val |= FRANK_E1000E_TCTL_MULR;
 
 	frank_e1000e_writel(adapter->hw, FRANK_E1000E_TCTL_REG, val);
+}
 
-	pci_info(pdev, "TX ring initialize with %u descriptors\n",
-			adapter->tx_ring_size);
+/* Give back every in-flight TX buffer once the TX unit has been stopped */
+static void frank_e1000e_drain_tx_ring(struct frank_e1000e_adapter *adapter,
+		struct frank_e1000e_tx_ring *tx_ring)
+{
+	struct pci_dev *pdev = adapter->pci;
+	struct frank_e1000e_tx_buffer *buffer_info;
+	int i;
 
-	return 0; 
+	for (i = 0; i < tx_ring->count; i++) {
+		buffer_info = &tx_ring->buffer_info[i];
+		if (buffer_info->skb) {
+			dma_unmap_single(&pdev->dev, buffer_info->dma,
+					buffer_info->length, DMA_TO_DEVICE);
+			dev_kfree_skb_any(buffer_info->skb);
+			buffer_info->skb = NULL;
+		}
+		buffer_info->length = 0;
+	}
+
+	memset(tx_ring->desc, 0,
+			tx_ring->count * sizeof(struct frank_e1000e_tx_desc));
+	tx_ring->head = 0;
+	tx_ring->tail = 0;
 }
 
-static void frank_e1000e_free_rx_ring(struct frank_e1000e_adapter *adapter)
+/* Unmap and free every posted RX buffer, the descriptor memory is kept */
+void frank_e1000e_free_rx_buffers(struct frank_e1000e_adapter *adapter)
 {
 	int i;
 	struct pci_dev *pdev = adapter->pci;
+	struct frank_e1000e_rx_buffer *buffer_info;
 
-	if( adapter->rx_skb == NULL || adapter->rx_ring_size == 0)
-		return;
-
-	for (i = 0; i < adapter->rx_ring_size; i++) {
-		if (!adapter->rx_skb[i])
+	for (i = 0; i < adapter->rx_ring.count; i++) {
+		buffer_info = &adapter->rx_ring.buffer_info[i];
+		if (!buffer_info->skb)
 			continue;
-		
-		dma_unmap_single(&pdev->dev, le64_to_cpu(adapter->rx_ring[i].buffer_addr),
+
+		dma_unmap_single(&pdev->dev, buffer_info->dma,
 				2048, DMA_FROM_DEVICE);
-		dev_kfree_skb(adapter->rx_skb[i]);
-		adapter->rx_skb[i] = NULL;
+		dev_kfree_skb(buffer_info->skb);
+		buffer_info->skb = NULL;
 	}
-
-	pci_info(pdev, "RX ring resources freed\n");
 }
 
-static int frank_e1000e_setup_rx_ring(struct frank_e1000e_adapter *adapter)
+/*
+ * Post a fresh buffer in every RX slot. Runs on each open, the ring itself
+ * was allocated once at probe and is reused as is.
+ */
+int frank_e1000e_alloc_rx_buffers(struct frank_e1000e_adapter *adapter)
 {
-	size_t size;
-	u64 tdba;
-	u32 val;
 	int i;
 	struct pci_dev *pdev = adapter->pci;
 	struct sk_buff *skb;
 	dma_addr_t dma_addr;
+	int node = adapter->rx_ring.numa_node;
+
+	memset(adapter->rx_ring.desc, 0,
+			adapter->rx_ring.count * sizeof(union frank_e1000e_rx_desc));
+
+	for (i = 0; i < adapter->rx_ring.count; i++) {
+		/*
+		 * Open runs on any CPU, so the fill cannot rely on the local
+		 * page frag cache like the refill in the NAPI poll does.
+		 */
+		skb = __alloc_skb(NET_SKB_PAD + NET_IP_ALIGN + 2048, GFP_KERNEL,
+				0, node);
+		if (!skb)
+			goto clean_skbs;
+
+		skb_reserve(skb, NET_SKB_PAD + NET_IP_ALIGN);
+		skb->dev = adapter->netdev;
 
-	adapter->rx_ring_size = FRANK_E1000E_RX_RING_SIZE;
+		dma_addr = dma_map_single(&pdev->dev, skb->data, 2048, DMA_FROM_DEVICE);
+		if (dma_mapping_error(&pdev->dev, dma_addr)) {
+			dev_kfree_skb(skb);
+			goto clean_skbs;
+		}
+
+		adapter->rx_ring.desc[i].read.buffer_addr = cpu_to_le64(dma_addr);
+		adapter->rx_ring.buffer_info[i].dma = dma_addr;
+		adapter->rx_ring.buffer_info[i].skb = skb;
+	}
+
+	adapter->rx_ring.next_to_clean = 0;
+	adapter->rx_ring.tail = adapter->rx_ring.count - 1;
+
+	return 0;
+
+clean_skbs:
+	pci_err(pdev, "Failed to alloc rx buffers\n");
+	frank_e1000e_free_rx_buffers(adapter);
+
+	return -ENOMEM;
+}
+
+static int frank_e1000e_setup_rx_ring(struct frank_e1000e_adapter *adapter)
+{
+	size_t size;
+	struct pci_dev *pdev = adapter->pci;
 
-	adapter->rx_head = 0;
-	adapter->rx_tail = adapter->rx_ring_size - 1;
+	adapter->rx_ring.count = FRANK_E1000E_RX_RING_SIZE;
 
-	size = adapter->rx_ring_size * sizeof(struct frank_e1000e_legacy_rx_desc);
+	size = adapter->rx_ring.count * sizeof(union frank_e1000e_rx_desc);
 	size = ALIGN(size, 4096);
 
-	adapter->rx_ring = dmam_alloc_coherent(&pdev->dev, size, 
-						&adapter->rx_ring_dma, GFP_KERNEL);
-	if (!adapter->rx_ring) {
+	adapter->rx_ring.desc = dmam_alloc_coherent(&pdev->dev, size, 
+						&adapter->rx_ring.dma, GFP_KERNEL);
+	if (!adapter->rx_ring.desc) {
 		pci_err(pdev, "Failed to alloc rx ring\n");
 		return -ENOMEM;
 	}
 
-	adapter->rx_skb = devm_kzalloc(&pdev->dev, sizeof(struct sk_buff *) * adapter->rx_ring_size,
-								GFP_KERNEL);
-	if (!adapter->rx_skb) {
-		pci_err(pdev, "Failed to alloc rx_skb\n");
+	adapter->rx_ring.buffer_info = devm_kcalloc(&pdev->dev, adapter->rx_ring.count,
+						sizeof(struct frank_e1000e_rx_buffer), GFP_KERNEL);
+	if (!adapter->rx_ring.buffer_info) {
+		pci_err(pdev, "Failed to alloc rx_buffer_info\n");
 		return -ENOMEM;
 	}
 
-	for (i = 0; i < adapter->rx_ring_size; i++) {
-		skb = netdev_alloc_skb(adapter->netdev, 2048 + NET_IP_ALIGN);
-		if (!skb) {
-			goto clean_skbs;
-		}
+	pci_info(pdev, "RX ring initialize with %u descriptors\n",
+			adapter->rx_ring.count);
 
-		skb_reserve(skb, NET_IP_ALIGN);
+	return 0;
+}
 
-		dma_addr = dma_map_single(&pdev->dev, skb->data, 2048, DMA_FROM_DEVICE);
-		if (dma_mapping_error(&pdev->dev, dma_addr)) {
-			dev_kfree_skb(skb);
-			goto clean_skbs;
-		}
+/*
+ * RSS is only used for its hash, there is a single RX queue so every
+ * redirection table entry points at queue 0.
+ */
+static void frank_e1000e_config_rss(struct frank_e1000e_adapter *adapter)
+{
+	u32 key[FRANK_E1000E_RSSRK_WORDS];
+	u32 val;
+	int i;
 
-		adapter->rx_ring[i].buffer_addr = cpu_to_le64(dma_addr);
-		adapter->rx_skb[i] = skb;
-	}
+	netdev_rss_key_fill(key, sizeof(key));
+	for (i = 0; i < FRANK_E1000E_RSSRK_WORDS; i++)
+		frank_e1000e_writel(adapter->hw, FRANK_E1000E_RSSRK_REG(i), key[i]);
 
-	tdba = adapter->rx_ring_dma; 
-	size = adapter->rx_ring_size * sizeof(struct frank_e1000e_legacy_rx_desc);
+	for (i = 0; i < FRANK_E1000E_RETA_WORDS; i++)
+		frank_e1000e_writel(adapter->hw, FRANK_E1000E_RETA_REG(i), 0);
+
+	val = frank_e1000e_readl(adapter->hw, FRANK_E1000E_RXCSUM_REG);
+	val |= FRANK_E1000E_RXCSUM_PCSD;
+	frank_e1000e_writel(adapter->hw, FRANK_E1000E_RXCSUM_REG, val);
+
+	val = FRANK_E1000E_MRQC_RSS_EN |
+		FRANK_E1000E_MRQC_TCP_IPV4 | FRANK_E1000E_MRQC_IPV4 |
+		FRANK_E1000E_MRQC_TCP_IPV6_EX | FRANK_E1000E_MRQC_IPV6_EX |
+		FRANK_E1000E_MRQC_IPV6;
+	frank_e1000e_writel(adapter->hw, FRANK_E1000E_MRQC_REG, val);
+}
+
+static void frank_e1000e_configure_rx(struct frank_e1000e_adapter *adapter)
+{
+	size_t size;
+	u64 tdba;
+	u32 val;
+
+	tdba = adapter->rx_ring.dma; 
+	size = adapter->rx_ring.count * sizeof(union frank_e1000e_rx_desc);
 
 	frank_e1000e_writel(adapter->hw, FRANK_E1000E_RDBAL0_REG, tdba & DMA_BIT_MASK(32));
 	frank_e1000e_writel(adapter->hw, FRANK_E1000E_RDBAH0_REG, (tdba >> 32) & 0xFFFFFFFF);
 	frank_e1000e_writel(adapter->hw, FRANK_E1000E_RDLEN0_REG, size);
-	frank_e1000e_writel(adapter->hw, FRANK_E1000E_RDH0_REG, adapter->rx_head);
-	frank_e1000e_writel(adapter->hw, FRANK_E1000E_RDT0_REG, adapter->rx_tail);
+	frank_e1000e_writel(adapter->hw, FRANK_E1000E_RDH0_REG, adapter->rx_ring.next_to_clean);
+	frank_e1000e_writel(adapter->hw, FRANK_E1000E_RDT0_REG, adapter->rx_ring.tail);
+
+	frank_e1000e_config_rx_thresholds(adapter);
 
 	val = frank_e1000e_readl(adapter->hw, FRANK_E1000E_RCTL_REG);
 	val |= FRANK_E1000E_RCTL_EN;
@@ -654,62 +1900,277 @@ static int frank_e1000e_setup_rx_ring(struct frank_e1000e_adapter *adapter)
 	frank_e1000e_writel(adapter->hw, FRANK_E1000E_RCTL_REG, val);
 
 	val = frank_e1000e_readl(adapter->hw, FRANK_E1000E_RFCTL_REG);
-	val &= ~FRANK_E1000E_RFCTL_EXSTEN;
+	if (adapter->rx_ring.ext)
+		val |= FRANK_E1000E_RFCTL_EXSTEN;
+	else
+		val &= ~FRANK_E1000E_RFCTL_EXSTEN;
 	frank_e1000e_writel(adapter->hw, FRANK_E1000E_RFCTL_REG, val);
 
-	pci_info(pdev, "RX ring initialize with %u descriptors\n",
-			adapter->rx_ring_size);
+	val = frank_e1000e_readl(adapter->hw, FRANK_E1000E_RXCSUM_REG);
+	val |= FRANK_E1000E_RXCSUM_IPOFL | FRANK_E1000E_RXCSUM_TUOFL;
+	frank_e1000e_writel(adapter->hw, FRANK_E1000E_RXCSUM_REG, val);
 
-	return 0;
+	if (adapter->rx_ring.ext)
+		frank_e1000e_config_rss(adapter);
+}
 
-clean_skbs:
-	frank_e1000e_free_rx_ring(adapter);
+/* Hand every posted RX buffer back to the hardware from slot 0 */
+static void frank_e1000e_reset_rx_ring(struct frank_e1000e_adapter *adapter)
+{
+	int i;
 
-	return -ENOMEM;
+	for (i = 0; i < adapter->rx_ring.count; i++) {
+		adapter->rx_ring.desc[i].read.buffer_addr =
+				cpu_to_le64(adapter->rx_ring.buffer_info[i].dma);
+		adapter->rx_ring.desc[i].read.reserved = 0;
+	}
+
+	adapter->rx_ring.next_to_clean = 0;
+	adapter->rx_ring.tail = adapter->rx_ring.count - 1;
+}
+
+static void frank_e1000e_sync_irqs(struct frank_e1000e_adapter *adapter)
+{
+	struct pci_dev *pdev = adapter->pci;
+	int i, nvec = adapter->msix_enabled ? FRANK_E1000E_MSIX_VECTORS : 1;
+
+	for (i = 0; i < nvec; i++)
+		synchronize_irq(pci_irq_vector(pdev, i));
+}
+
+void frank_e1000e_up(struct frank_e1000e_adapter *adapter)
+{
+	struct net_device *netdev = adapter->netdev;
+	unsigned int i;
+
+	frank_e1000e_configure_tx(adapter);
+	frank_e1000e_configure_rx(adapter);
+
+	clear_bit(__FRANK_E1000E_DOWN, &adapter->state);
+
+	napi_enable(&adapter->rx_napi);
+	if (adapter->msix_enabled)
+		napi_enable(&adapter->tx_napi);
+
+	/* Report which NAPI instance serves each queue over netdev netlink */
+	netif_queue_set_napi(netdev, 0, NETDEV_QUEUE_TYPE_RX, &adapter->rx_napi);
+	for (i = 0; i < adapter->num_tx_queues; i++)
+		netif_queue_set_napi(netdev, i, NETDEV_QUEUE_TYPE_TX,
+				adapter->msix_enabled ? &adapter->tx_napi : &adapter->rx_napi);
+
+	frank_e1000e_enable_intr(adapter);
+
+	/* Pinned, so the rings are serviced on the CPU that opened the interface */
+	if (adapter->poll_interval)
+		hrtimer_start(&adapter->poll_timer, adapter->poll_interval,
+				HRTIMER_MODE_REL_PINNED);
+
+	frank_e1000e_set_link_state(adapter, 1);
+
+	netif_carrier_on(netdev);
+	netif_tx_start_all_queues(netdev);
+}
+
+void frank_e1000e_down(struct frank_e1000e_adapter *adapter)
+{
+	struct net_device *netdev = adapter->netdev;
+	unsigned int i;
+	u32 val;
+
+	set_bit(__FRANK_E1000E_DOWN, &adapter->state);
+
+	netif_carrier_off(netdev);
+	netif_tx_disable(netdev);
+
+	val = frank_e1000e_readl(adapter->hw, FRANK_E1000E_RCTL_REG);
+	frank_e1000e_writel(adapter->hw, FRANK_E1000E_RCTL_REG,
+			val & ~FRANK_E1000E_RCTL_EN);
+	val = frank_e1000e_readl(adapter->hw, FRANK_E1000E_TCTL_REG);
+	frank_e1000e_writel(adapter->hw, FRANK_E1000E_TCTL_REG,
+			val & ~FRANK_E1000E_TCTL_EN);
+
+	/* Flush the disables and let DMA already in flight land */
+	frank_e1000e_readl(adapter->hw, FRANK_E1000E_STATUS_REG);
+	usleep_range(1000, 2000);
+
+	frank_e1000e_disable_intr(adapter);
+	frank_e1000e_sync_irqs(adapter);
+	hrtimer_cancel(&adapter->poll_timer);
+
+	netif_queue_set_napi(netdev, 0, NETDEV_QUEUE_TYPE_RX, NULL);
+	for (i = 0; i < adapter->num_tx_queues; i++)
+		netif_queue_set_napi(netdev, i, NETDEV_QUEUE_TYPE_TX, NULL);
+
+	napi_disable(&adapter->rx_napi);
+	if (adapter->msix_enabled)
+		napi_disable(&adapter->tx_napi);
+
+	cancel_work_sync(&adapter->link_task);
+
+	frank_e1000e_set_link_state(adapter, 0);
+
+	for (i = 0; i < adapter->num_tx_queues; i++)
+		frank_e1000e_drain_tx_ring(adapter, &adapter->tx_ring[i]);
+	frank_e1000e_reset_rx_ring(adapter);
+}
+
+/* Bring the MAC back to the state probe left it in, rings excluded */
+static void frank_e1000e_reset_hw(struct frank_e1000e_adapter *adapter)
+{
+	frank_e1000e_disable_intr(adapter);
+
+	frank_e1000e_config_pba(adapter);
+
+	frank_e1000e_reset_start(adapter);
+	if (frank_e1000e_reset_wait(adapter))
+		pci_warn(adapter->pci, "Continuing with a partially reset MAC\n");
+
+	frank_e1000e_hw_init(adapter);
+
+	if (adapter->msix_enabled) {
+		frank_e1000e_config_msix(adapter);
+	} else {
+		frank_e1000e_config_icr_auto_mask(adapter);
+		frank_e1000e_config_itr(adapter);
+	}
+
+	mutex_lock(&adapter->fc_lock);
+	frank_e1000e_config_fc(adapter);
+	mutex_unlock(&adapter->fc_lock);
+}
+
+/*
+ * Reset the MAC underneath a running interface. The netdev stays
+ * registered and the rings keep their memory, only the in-flight TX
+ * buffers are dropped. Called with RTNL held.
+ */
+static void frank_e1000e_reinit_locked(struct frank_e1000e_adapter *adapter)
+{
+	ktime_t start = ktime_get();
+
+	frank_e1000e_down(adapter);
+	frank_e1000e_reset_hw(adapter);
+	frank_e1000e_up(adapter);
+
+	adapter->resets++;
+	adapter->reset_last_us = ktime_us_delta(ktime_get(), start);
+
+	pci_info(adapter->pci, "Reset done in %llu us\n", adapter->reset_last_us);
+}
+
+void frank_e1000e_reinit(struct frank_e1000e_adapter *adapter)
+{
+	struct net_device *netdev = adapter->netdev;
+
+	rtnl_lock();
+	/* Error recovery or a close may have beaten us to it */
+	if (netif_running(netdev) && netif_device_present(netdev))
+		frank_e1000e_reinit_locked(adapter);
+	rtnl_unlock();
+}
+
+/* The tx health reporter dumps the hung ring, then calls frank_e1000e_reinit() */
+static void frank_e1000e_reset_task(struct work_struct *work)
+{
+	struct frank_e1000e_adapter *adapter = container_of(work,
+					struct frank_e1000e_adapter, reset_task);
+
+	frank_e1000e_devlink_tx_report(adapter, READ_ONCE(adapter->tx_hang_queue));
+}
+
+static void frank_e1000e_restart_task(struct work_struct *work)
+{
+	struct frank_e1000e_adapter *adapter = container_of(work,
+					struct frank_e1000e_adapter, restart_task);
+
+	frank_e1000e_reinit(adapter);
+}
+
+static void frank_e1000e_config_aspm(struct frank_e1000e_adapter *adapter)
+{
+	struct pci_dev *pdev = adapter->pci;
+	int ret;
+
+	if (aspm_l1 < 0)
+		return;
+
+	if (aspm_l1)
+		ret = pci_enable_link_state(pdev, PCIE_LINK_STATE_L1);
+	else
+		ret = pci_disable_link_state(pdev, PCIE_LINK_STATE_L1);
+
+	if (ret)
+		pci_warn(pdev, "Failed to %s ASPM L1\n",
+				aspm_l1 ? "enable" : "disable");
 }
 
 static int frank_e1000e_init(struct frank_e1000e_adapter *adapter)
 {
 	struct pci_dev *pdev = adapter->pci;
+	unsigned int i;
 	int ret;
 	
 	pci_info(pdev, "Init frank e1000e\n");
 
 	frank_e1000e_disable_intr(adapter);
-	
-	frank_e1000e_sw_reset(adapter);
-	
-	frank_e1000e_hw_init(adapter);
 
-	ret = frank_e1000e_init_irq(adapter);
+	/* config_pba sizes the FIFOs from the MTU, the netdev must exist */
+	ret = frank_e1000e_alloc_netdev(adapter);
 	if (ret) {
 		goto error;
 	}
 
-	ret = frank_e1000e_setup_tx_ring(adapter);
-	if (ret) {
-		goto error;
+	frank_e1000e_config_pba(adapter);
+
+	frank_e1000e_reset_start(adapter);
+
+	/* Nothing below touches the device until reset_wait */
+	for (i = 0; i < adapter->num_tx_queues; i++) {
+		ret = frank_e1000e_setup_tx_ring(adapter, &adapter->tx_ring[i]);
+		if (ret) {
+			goto free_netdev;
+		}
 	}
 
 	ret = frank_e1000e_setup_rx_ring(adapter);
 	if (ret) {
-		goto error;
+		goto free_netdev;
 	}
 
-	ret = frank_e1000e_read_mac_addr(adapter);
+	ret = frank_e1000e_reset_wait(adapter);
 	if (ret) {
-		goto error;
+		goto free_netdev;
 	}
 
-	ret = frank_e1000e_init_netdev(adapter);
+	frank_e1000e_hw_init(adapter);
+
+	ret = frank_e1000e_init_irq(adapter);
 	if (ret) {
-		goto error;
+		goto free_netdev;
 	}
 
-	frank_e1000e_enable_intr(adapter);
+	ret = frank_e1000e_init_nvm(adapter);
+	if (ret) {
+		goto clear_affinity;
+	}
+
+	frank_e1000e_read_mac_addr(adapter);
+
+	frank_e1000e_init_fc(adapter);
+
+	frank_e1000e_config_aspm(adapter);
+
+	ret = frank_e1000e_init_netdev(adapter);
+	if (ret) {
+		goto clear_affinity;
+	}
 
 	return 0;
 
+clear_affinity:
+	frank_e1000e_clear_irq_affinity(adapter);
+free_netdev:
+	frank_e1000e_free_netdev(adapter);
 error:
 	return ret;
 }
@@ -719,6 +2180,7 @@ static int frank_e1000e_probe(struct pci_dev *pdev, const struct pci_device_id *
 	struct frank_e1000e_adapter *adapter;
 	struct frank_e1000e_hw *hw;
 	struct device *dev = &pdev->dev;
+	unsigned int i;
 	int ret;
 
 	pci_info(pdev, "In Frank e1000e test driver probe function\n");
@@ -739,6 +2201,43 @@ static int frank_e1000e_probe(struct pci_dev *pdev, const struct pci_device_id *
 
 	adapter->pci = pdev;
 	adapter->hw = hw;
+	hw->info = (const struct frank_e1000e_info *)id->driver_data;
+	set_bit(__FRANK_E1000E_DOWN, &adapter->state);
+	adapter->rx_ring.copybreak = min_t(u32, rx_copybreak,
+					FRANK_E1000E_RX_COPYBREAK_MAX);
+	adapter->num_tx_queues = hw->info->num_tx_queues;
+	for (i = 0; i < adapter->num_tx_queues; i++) {
+		adapter->tx_ring[i].index = i;
+		adapter->tx_ring[i].copybreak = min_t(u32, tx_copybreak,
+						FRANK_E1000E_TX_BOUNCE_SIZE);
+		u64_stats_init(&adapter->tx_ring[i].stats.syncp);
+		u64_stats_init(&adapter->tx_ring[i].xmit_stats.syncp);
+	}
+	adapter->tx_weight[0] = clamp_t(u32, tx_weight0, 1, FRANK_E1000E_TX_WEIGHT_MAX);
+	adapter->tx_weight[1] = clamp_t(u32, tx_weight1, 1, FRANK_E1000E_TX_WEIGHT_MAX);
+	adapter->rx_ring.ext = !!(hw->info->flags & FRANK_E1000E_FLAG_EXT_RX);
+	adapter->rx_ring.numa_node = dev_to_node(dev);
+	adapter->rx_pthresh = min_t(u32, rx_pthresh, FRANK_E1000E_DCTL_THRESH_MAX);
+	adapter->rx_hthresh = min_t(u32, rx_hthresh, FRANK_E1000E_DCTL_THRESH_MAX);
+	adapter->rx_wthresh = clamp_t(u32, rx_wthresh, 1, FRANK_E1000E_DCTL_THRESH_MAX);
+	adapter->tx_pthresh = min_t(u32, tx_pthresh, FRANK_E1000E_DCTL_THRESH_MAX);
+	adapter->tx_hthresh = min_t(u32, tx_hthresh, FRANK_E1000E_DCTL_THRESH_MAX);
+	adapter->tx_wthresh = clamp_t(u32, tx_wthresh, 1, FRANK_E1000E_DCTL_THRESH_MAX);
+	adapter->rx_delay_us = min_t(u32, rx_delay_us, FRANK_E1000E_DELAY_MAX_USECS);
+	adapter->rx_abs_delay_us = min_t(u32, rx_abs_delay_us, FRANK_E1000E_DELAY_MAX_USECS);
+	u64_stats_init(&adapter->rx_ring.stats.syncp);
+	INIT_WORK(&adapter->link_task, frank_e1000e_link_task);
+	INIT_WORK(&adapter->reset_task, frank_e1000e_reset_task);
+	INIT_WORK(&adapter->restart_task, frank_e1000e_restart_task);
+	mutex_init(&adapter->fc_lock);
+	if (poll_us && poll_us < FRANK_E1000E_POLL_MIN_US)
+		pci_warn(pdev, "poll_us %u adjusted to %u\n", poll_us,
+				FRANK_E1000E_POLL_MIN_US);
+	adapter->poll_interval = poll_us ?
+			us_to_ktime(max_t(u32, poll_us, FRANK_E1000E_POLL_MIN_US)) : 0;
+	adapter->ims = poll_us ? FRANK_E1000E_INT_POLL_MODE : FRANK_E1000E_INT_ALL;
+	hrtimer_setup(&adapter->poll_timer, frank_e1000e_poll_timer,
+			CLOCK_MONOTONIC, HRTIMER_MODE_REL_PINNED);
 	hw->adapter = adapter;
 	hw->device_id = id->device;
 	hw->vendor_id = id->vendor;
@@ -765,6 +2264,14 @@ static int frank_e1000e_probe(struct pci_dev *pdev, const struct pci_device_id *
 	}
 
 	pci_set_master(pdev);
+	pci_save_state(pdev);
+
+	/* The PCI core clears RELAX_EN below root ports known to mishandle it */
+	adapter->relaxed_ordering = relaxed_ordering &&
+			(hw->info->flags & FRANK_E1000E_FLAG_PCIE) &&
+			pcie_relaxed_ordering_enabled(pdev);
+	if (relaxed_ordering && !adapter->relaxed_ordering)
+		pci_info(pdev, "Relaxed ordering not available, keeping strict ordering\n");
 
 	if ((ret = dma_set_mask_and_coherent(&pdev->dev, DMA_BIT_MASK(64)))) {
 		pci_info(pdev, "DMA configuration 64 bit failed\n");
@@ -775,12 +2282,24 @@ static int frank_e1000e_probe(struct pci_dev *pdev, const struct pci_device_id *
 		}
 	}
 
+	ret = frank_e1000e_devlink_init(adapter);
+	if (ret)
+		goto error;
+
 	ret = frank_e1000e_init(adapter);
 	if (ret) {
 		pci_err(pdev, "Failed to init frank e1000e\n");
 		goto error;
 	}
 
+	/* Let the device idle in D3hot whenever the interface is down */
+	pm_runtime_set_autosuspend_delay(dev, FRANK_E1000E_AUTOSUSPEND_MS);
+	pm_runtime_use_autosuspend(dev);
+	pm_runtime_put_noidle(dev);
+	pm_runtime_allow(dev);
+
+	frank_e1000e_devlink_register(adapter);
+
 	return 0;
 
 error:
@@ -794,32 +2313,209 @@ static void frank_e1000e_remove(struct pci_dev *pdev)
 	pci_info(pdev, "In Frank e1000e test driver remove function\n");
 
 	if (adapter && adapter->netdev) {
-		
-		frank_e1000e_free_rx_ring(adapter);
-		
-
-		pci_free_irq_vectors(pdev);
+		pm_runtime_forbid(&pdev->dev);
+		pm_runtime_dont_use_autosuspend(&pdev->dev);
+		pm_runtime_get_noresume(&pdev->dev);
 
+		/* Closes the interface, which also gives back the RX buffers */
 		unregister_netdev(adapter->netdev);
-		free_netdev(adapter->netdev);
-		adapter->netdev = NULL;
+
+		cancel_work_sync(&adapter->link_task);
+		cancel_work_sync(&adapter->reset_task);
+
+		/* No health report can be in flight any more */
+		frank_e1000e_devlink_unregister(adapter);
+		cancel_work_sync(&adapter->restart_task);
+
+		/*
+		 * The IRQs and vectors are device managed and released after
+		 * we return, in that order.
+		 */
+		frank_e1000e_clear_irq_affinity(adapter);
+		frank_e1000e_free_netdev(adapter);
 	}
 }
 
+static const struct frank_e1000e_info frank_e1000e_info_8254x = {
+	.flags = 0,
+	.num_tx_queues = 1,
+	.pba_total_kb = FRANK_E1000E_PBA_TOTAL_8254X,
+	.pba_rx_kb = FRANK_E1000E_PBA_RX_8254X,
+	.eerd_addr_shift = FRANK_E1000E_EERD_ADDR_SHIFT_8254X,
+	.eerd_done = FRANK_E1000E_EERD_DONE_8254X,
+};
+
+/* PCIe with two TX queues and RSS, but MSI only */
+static const struct frank_e1000e_info frank_e1000e_info_82571 = {
+	.flags = FRANK_E1000E_FLAG_PCIE | FRANK_E1000E_FLAG_EXT_RX,
+	.num_tx_queues = FRANK_E1000E_MAX_TX_QUEUES,
+	.pba_total_kb = FRANK_E1000E_PBA_TOTAL_82571,
+	.pba_rx_kb = FRANK_E1000E_PBA_RX_82571,
+	.eerd_addr_shift = FRANK_E1000E_EERD_ADDR_SHIFT,
+	.eerd_done = FRANK_E1000E_EERD_DONE,
+};
+
+static const struct frank_e1000e_info frank_e1000e_info_82574 = {
+	.flags = FRANK_E1000E_FLAG_PCIE | FRANK_E1000E_FLAG_MSIX |
+			FRANK_E1000E_FLAG_EXT_RX,
+	.num_tx_queues = FRANK_E1000E_MAX_TX_QUEUES,
+	.pba_total_kb = FRANK_E1000E_PBA_TOTAL_82574,
+	.pba_rx_kb = FRANK_E1000E_PBA_RX_82574,
+	.eerd_addr_shift = FRANK_E1000E_EERD_ADDR_SHIFT,
+	.eerd_done = FRANK_E1000E_EERD_DONE,
+};
+
 static const struct pci_device_id frank_e1000e_pci_tbl[] = {
-	{PCI_DEVICE(PCI_VENDOR_ID_INTEL, FRANK_E1000E_DEV_ID_82540EM)},
-	{PCI_DEVICE(PCI_VENDOR_ID_INTEL, FRANK_E1000E_DEV_ID_82545EM)},
-	{PCI_DEVICE(PCI_VENDOR_ID_INTEL, FRANK_E1000E_DEV_ID_82571EB)},
-	{PCI_DEVICE(PCI_VENDOR_ID_INTEL, FRANK_E1000E_DEV_ID_82574L)},
+	{PCI_DEVICE(PCI_VENDOR_ID_INTEL, FRANK_E1000E_DEV_ID_82540EM),
+		.driver_data = (kernel_ulong_t)&frank_e1000e_info_8254x},
+	{PCI_DEVICE(PCI_VENDOR_ID_INTEL, FRANK_E1000E_DEV_ID_82545EM),
+		.driver_data = (kernel_ulong_t)&frank_e1000e_info_8254x},
+	{PCI_DEVICE(PCI_VENDOR_ID_INTEL, FRANK_E1000E_DEV_ID_82571EB),
+		.driver_data = (kernel_ulong_t)&frank_e1000e_info_82571},
+	{PCI_DEVICE(PCI_VENDOR_ID_INTEL, FRANK_E1000E_DEV_ID_82574L),
+		.driver_data = (kernel_ulong_t)&frank_e1000e_info_82574},
 	{},
 };
 MODULE_DEVICE_TABLE(pci, frank_e1000e_pci_tbl);
 
+static int frank_e1000e_suspend(struct device *dev)
+{
+	struct frank_e1000e_adapter *adapter = dev_get_drvdata(dev);
+	struct net_device *netdev = adapter->netdev;
+
+	rtnl_lock();
+	netif_device_detach(netdev);
+	if (netif_running(netdev))
+		frank_e1000e_down(adapter);
+	rtnl_unlock();
+
+	return 0;
+}
+
+/* Register state is gone after D3, the rings in memory are kept as they are */
+static int frank_e1000e_resume(struct device *dev)
+{
+	struct frank_e1000e_adapter *adapter = dev_get_drvdata(dev);
+	struct net_device *netdev = adapter->netdev;
+
+	frank_e1000e_reset_hw(adapter);
+
+	rtnl_lock();
+	if (netif_running(netdev))
+		frank_e1000e_up(adapter);
+	netif_device_attach(netdev);
+	rtnl_unlock();
+
+	return 0;
+}
+
+/* Only reached with the interface down, the rings are already quiesced */
+static int frank_e1000e_runtime_suspend(struct device *dev)
+{
+	struct frank_e1000e_adapter *adapter = dev_get_drvdata(dev);
+
+	frank_e1000e_disable_intr(adapter);
+
+	return 0;
+}
+
+/*
+ * Every wake-up ends up here, whoever asked for it. The PCI core has
+ * already taken the device out of D3hot, what is timed is the MAC reset.
+ */
+static int frank_e1000e_runtime_resume(struct device *dev)
+{
+	struct frank_e1000e_adapter *adapter = dev_get_drvdata(dev);
+	ktime_t start = ktime_get();
+	u64 us;
+
+	frank_e1000e_reset_hw(adapter);
+
+	us = ktime_us_delta(ktime_get(), start);
+	adapter->pm_resumes++;
+	adapter->pm_resume_last_us = us;
+	adapter->pm_resume_max_us = max(adapter->pm_resume_max_us, us);
+
+	return 0;
+}
+
+static const struct dev_pm_ops frank_e1000e_pm_ops = {
+	SYSTEM_SLEEP_PM_OPS(frank_e1000e_suspend, frank_e1000e_resume)
+	RUNTIME_PM_OPS(frank_e1000e_runtime_suspend,
+			frank_e1000e_runtime_resume, NULL)
+};
+
+static pci_ers_result_t frank_e1000e_io_error_detected(struct pci_dev *pdev,
+		pci_channel_state_t state)
+{
+	struct frank_e1000e_adapter *adapter = pci_get_drvdata(pdev);
+	struct net_device *netdev = adapter->netdev;
+
+	pci_warn(pdev, "PCI error detected, state %d\n", state);
+
+	rtnl_lock();
+	netif_device_detach(netdev);
+
+	if (state == pci_channel_io_perm_failure) {
+		rtnl_unlock();
+		return PCI_ERS_RESULT_DISCONNECT;
+	}
+
+	if (netif_running(netdev))
+		frank_e1000e_down(adapter);
+	rtnl_unlock();
+
+	pci_disable_device(pdev);
+
+	return PCI_ERS_RESULT_NEED_RESET;
+}
+
+static pci_ers_result_t frank_e1000e_io_slot_reset(struct pci_dev *pdev)
+{
+	struct frank_e1000e_adapter *adapter = pci_get_drvdata(pdev);
+
+	if (pci_enable_device_mem(pdev)) {
+		pci_err(pdev, "Failed to re-enable device after reset\n");
+		return PCI_ERS_RESULT_DISCONNECT;
+	}
+
+	pci_restore_state(pdev);
+	pci_save_state(pdev);
+	pci_set_master(pdev);
+
+	frank_e1000e_reset_hw(adapter);
+
+	return PCI_ERS_RESULT_RECOVERED;
+}
+
+static void frank_e1000e_io_resume(struct pci_dev *pdev)
+{
+	struct frank_e1000e_adapter *adapter = pci_get_drvdata(pdev);
+	struct net_device *netdev = adapter->netdev;
+
+	rtnl_lock();
+	if (netif_running(netdev))
+		frank_e1000e_up(adapter);
+	netif_device_attach(netdev);
+	rtnl_unlock();
+
+	pci_info(pdev, "Recovered from PCI error\n");
+}
+
+static const struct pci_error_handlers frank_e1000e_err_handler = {
+	.error_detected = frank_e1000e_io_error_detected,
+	.slot_reset = frank_e1000e_io_slot_reset,
+	.resume = frank_e1000e_io_resume,
+};
+
 static struct pci_driver frank_e1000e_driver = {
 	.name = DRIVER_NAME,
 	.id_table = frank_e1000e_pci_tbl,
 	.probe = frank_e1000e_probe,
 	.remove = frank_e1000e_remove,
+	.err_handler = &frank_e1000e_err_handler,
+	.driver.pm = pm_ptr(&frank_e1000e_pm_ops),
+	.driver.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 };
 
 module_pci_driver(frank_e1000e_driver);